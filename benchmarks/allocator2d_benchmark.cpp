@@ -0,0 +1,319 @@
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/mo_yanxi/allocator2d.hpp"
+
+namespace {
+
+using mo_yanxi::math::usize2;
+
+struct Workload {
+    const char* name;
+    std::uint32_t map_size;
+    int fill_attempts;
+    std::uint32_t min_size;
+    std::uint32_t max_size;
+};
+
+constexpr Workload workloads[] = {
+    {"Standard", 2048, 10000, 32, 256},
+    {"HighFragment", 1024, 10000, 4, 16},
+    {"Aligned", 1024, 10000, 16, 16},
+};
+
+const Workload& workload_of(const benchmark::State& state) {
+    return workloads[state.range(0)];
+}
+
+std::vector<usize2> make_sizes(const Workload& workload, std::uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<std::uint32_t> dist(workload.min_size, workload.max_size);
+    std::vector<usize2> sizes(workload.fill_attempts);
+    for (auto& size : sizes) {
+        size = {dist(rng), dist(rng)};
+    }
+    return sizes;
+}
+
+// Sizes and positions stay 32-bit here and are converted to the coordinate type of the allocator.
+template <typename Allocator>
+typename Allocator::point_type point_of(const usize2 point) {
+    return point.as<typename Allocator::size_type>();
+}
+
+template <typename Allocator>
+std::vector<usize2> fill(Allocator& alloc, const std::vector<usize2>& sizes) {
+    std::vector<usize2> positions;
+    positions.reserve(sizes.size());
+    for (const auto& size : sizes) {
+        if (auto pos = alloc.allocate(point_of<Allocator>(size))) {
+            positions.push_back(pos->template as<std::uint32_t>());
+        }
+    }
+    return positions;
+}
+
+// placed counts the rects that found room, so the search engines can be compared on occupancy as well;
+// bytes is the bookkeeping held with the map full
+template <typename Allocator = mo_yanxi::allocator2d<>>
+void run_fill(benchmark::State& state, const bool subtree_search) {
+    const auto& workload = workload_of(state);
+    const auto sizes = make_sizes(workload, 42);
+    std::size_t placed = 0;
+    std::size_t bytes = 0;
+
+    for (auto _ : state) {
+        Allocator alloc{point_of<Allocator>({workload.map_size, workload.map_size})};
+        alloc.use_subtree_search(subtree_search);
+        auto positions = fill(alloc, sizes);
+        benchmark::DoNotOptimize(positions.data());
+        placed = positions.size();
+        bytes = alloc.memory_usage().total();
+        for (const auto& pos : positions) {
+            alloc.deallocate(point_of<Allocator>(pos));
+        }
+    }
+    state.SetLabel(workload.name);
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(sizes.size()));
+    state.counters["placed"] = static_cast<double>(placed);
+    state.counters["bytes"] = static_cast<double>(bytes);
+}
+
+void BM_Fill(benchmark::State& state) {
+    run_fill(state, false);
+}
+
+void BM_SubtreeFill(benchmark::State& state) {
+    run_fill(state, true);
+}
+
+// 16-bit coordinates, which every workload fits; compare with BM_Fill and BM_Churn.
+using narrow_allocator = mo_yanxi::allocator2d<std::allocator<std::byte>, std::uint16_t>;
+
+void BM_NarrowFill(benchmark::State& state) {
+    run_fill<narrow_allocator>(state, false);
+}
+
+// Lookup-heavy: every iteration frees all live rects in random order, which is dominated by the point lookups
+// and the parent walk of each deallocation.
+void BM_DeallocateAll(benchmark::State& state) {
+    const auto& workload = workload_of(state);
+    const auto sizes = make_sizes(workload, 42);
+    std::mt19937 rng(7);
+    std::size_t released = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        mo_yanxi::allocator2d<> alloc{{workload.map_size, workload.map_size}};
+        auto positions = fill(alloc, sizes);
+        std::ranges::shuffle(positions, rng);
+        state.ResumeTiming();
+
+        for (const auto& pos : positions) {
+            benchmark::DoNotOptimize(alloc.deallocate(pos));
+        }
+        released += positions.size();
+    }
+    state.SetLabel(workload.name);
+    state.SetItemsProcessed(static_cast<std::int64_t>(released));
+}
+
+void BM_DeallocateAllHandles(benchmark::State& state) {
+    const auto& workload = workload_of(state);
+    const auto sizes = make_sizes(workload, 42);
+    std::mt19937 rng(7);
+    std::size_t released = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        mo_yanxi::allocator2d<> alloc{{workload.map_size, workload.map_size}};
+        std::vector<mo_yanxi::allocator2d<>::allocation_handle> handles;
+        handles.reserve(sizes.size());
+        for (const auto& size : sizes) {
+            if (auto handle = alloc.allocate_handle(size)) {
+                handles.push_back(*handle);
+            }
+        }
+        std::ranges::shuffle(handles, rng);
+        state.ResumeTiming();
+
+        for (const auto& handle : handles) {
+            benchmark::DoNotOptimize(alloc.deallocate(handle));
+        }
+        released += handles.size();
+    }
+    state.SetLabel(workload.name);
+    state.SetItemsProcessed(static_cast<std::int64_t>(released));
+}
+
+// Steady-state churn: release half of the live rects and refill with fresh sizes, repeatedly.
+template <typename Allocator>
+void churn(benchmark::State& state, Allocator& alloc, const Workload& workload) {
+    const auto sizes = make_sizes(workload, 42);
+    const auto refill_sizes = make_sizes(workload, 1337);
+    std::mt19937 rng(7);
+
+    auto positions = fill(alloc, sizes);
+    std::size_t refill_cursor = 0;
+    std::size_t operations = 0;
+
+    for (auto _ : state) {
+        std::ranges::shuffle(positions, rng);
+        const auto release_count = positions.size() / 2;
+        for (std::size_t i = 0; i < release_count; ++i) {
+            alloc.deallocate(point_of<Allocator>(positions.back()));
+            positions.pop_back();
+        }
+        for (std::size_t i = 0; i < release_count; ++i) {
+            const auto& size = refill_sizes[refill_cursor++ % refill_sizes.size()];
+            if (auto pos = alloc.allocate(point_of<Allocator>(size))) {
+                positions.push_back(pos->template as<std::uint32_t>());
+            }
+        }
+        operations += release_count * 2;
+    }
+    state.SetLabel(workload.name);
+    state.SetItemsProcessed(static_cast<std::int64_t>(operations));
+    state.counters["live"] = static_cast<double>(positions.size());
+
+    for (const auto& pos : positions) {
+        alloc.deallocate(point_of<Allocator>(pos));
+    }
+}
+
+template <typename Allocator = mo_yanxi::allocator2d<>>
+void run_churn(benchmark::State& state, const bool subtree_search) {
+    const auto& workload = workload_of(state);
+    Allocator alloc{point_of<Allocator>({workload.map_size, workload.map_size})};
+    alloc.use_subtree_search(subtree_search);
+    churn(state, alloc, workload);
+}
+
+void BM_Churn(benchmark::State& state) {
+    run_churn(state, false);
+}
+
+void BM_SubtreeChurn(benchmark::State& state) {
+    run_churn(state, true);
+}
+
+void BM_NarrowChurn(benchmark::State& state) {
+    run_churn<narrow_allocator>(state, false);
+}
+
+// The buddy allocator on the Aligned workload, whose requests are all power-of-two squares; compare with
+// BM_Fill/2 and BM_Churn/2.
+void BM_BuddyFill(benchmark::State& state) {
+    const auto& workload = workloads[2];
+    const auto sizes = make_sizes(workload, 42);
+    std::size_t placed = 0;
+
+    for (auto _ : state) {
+        mo_yanxi::buddy_allocator2d<> alloc{workload.map_size, workload.min_size};
+        auto positions = fill(alloc, sizes);
+        benchmark::DoNotOptimize(positions.data());
+        placed = positions.size();
+        for (const auto& pos : positions) {
+            alloc.deallocate(pos);
+        }
+    }
+    state.SetLabel(workload.name);
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(sizes.size()));
+    state.counters["placed"] = static_cast<double>(placed);
+}
+
+void BM_BuddyChurn(benchmark::State& state) {
+    const auto& workload = workloads[2];
+    mo_yanxi::buddy_allocator2d<> alloc{workload.map_size, workload.min_size};
+    churn(state, alloc, workload);
+}
+
+// Churn whose request sizes alternate between a glyph-heavy and an icon-heavy phase; arg 1 enables the
+// adaptive fragment threshold, arg 0 keeps the fixed default.
+void BM_ShiftingChurn(benchmark::State& state) {
+    constexpr Workload phases[] = {
+        {"Glyphs", 2048, 20000, 4, 16},
+        {"Icons", 2048, 2000, 48, 128},
+    };
+    // refills that keep each phase near half occupancy
+    constexpr std::size_t refill_counts[] = {8000, 200};
+    const auto glyphs = make_sizes(phases[0], 42);
+    const auto icons = make_sizes(phases[1], 1337);
+    std::mt19937 rng(7);
+
+    mo_yanxi::allocator2d<> alloc{{2048, 2048}};
+    alloc.adapt_fragment_threshold(state.range(0) != 0);
+    std::vector<usize2> positions;
+    std::size_t cursor = 0;
+    std::size_t operations = 0;
+
+    for (auto _ : state) {
+        const auto phase = (operations / 100000) % 2;
+        const auto& sizes = phase ? icons : glyphs;
+        std::ranges::shuffle(positions, rng);
+        const auto release_count = positions.size() / 2;
+        for (std::size_t i = 0; i < release_count; ++i) {
+            alloc.deallocate(positions.back());
+            positions.pop_back();
+        }
+        for (std::size_t i = 0; i < refill_counts[phase]; ++i) {
+            if (auto pos = alloc.allocate(sizes[cursor++ % sizes.size()])) {
+                positions.push_back(*pos);
+            }
+        }
+        operations += release_count + refill_counts[phase];
+    }
+    state.SetLabel(state.range(0) ? "adaptive" : "fixed");
+    state.SetItemsProcessed(static_cast<std::int64_t>(operations));
+
+    for (const auto& pos : positions) {
+        alloc.deallocate(pos);
+    }
+}
+
+// Aligned mip allocations on four 4096x4096 layers crowded with glyphs; the argument is the glyphs per layer and
+// the "nodes" counter the total node count of the layers, which the index search should barely feel.
+void BM_LayeredMip(benchmark::State& state) {
+    const Workload glyphs{"Glyphs", 4096, static_cast<int>(state.range(0)), 4, 16};
+    constexpr std::uint32_t layer_count = 4;
+    mo_yanxi::layered_allocator2d<> alloc{{glyphs.map_size, glyphs.map_size}, layer_count};
+    for (std::uint32_t i = 0; i < layer_count; ++i) {
+        for (const auto& size : make_sizes(glyphs, 42 + i)) {
+            benchmark::DoNotOptimize(alloc.allocate(size));
+        }
+    }
+
+    const auto sizes = make_sizes({"Icons", 4096, 256, 32, 96}, 7);
+    std::size_t cursor = 0;
+    for (auto _ : state) {
+        const auto allocation = alloc.allocate_mip(sizes[cursor++ % sizes.size()], 4);
+        benchmark::DoNotOptimize(allocation);
+        if (allocation) alloc.deallocate(*allocation);
+    }
+    std::size_t nodes = 0;
+    for (std::uint32_t i = 0; i < layer_count; ++i) nodes += alloc.layer(i).node_count();
+    state.counters["nodes"] = static_cast<double>(nodes);
+    state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_Fill)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_DeallocateAll)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_DeallocateAllHandles)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_Churn)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_SubtreeFill)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_SubtreeChurn)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_NarrowFill)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_NarrowChurn)->DenseRange(0, 2)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_BuddyFill)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_BuddyChurn)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_ShiftingChurn)->DenseRange(0, 1)->Unit(benchmark::kMicrosecond);
+BENCHMARK(BM_LayeredMip)->Arg(2500)->Arg(10000)->Arg(40000)->Unit(benchmark::kMicrosecond);
+
+} // namespace
+
+BENCHMARK_MAIN();
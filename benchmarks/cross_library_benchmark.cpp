@@ -0,0 +1,324 @@
+// Cross-library benchmark: runs allocator2d and a set of reference packers over the same
+// Standard/HighFragment/Aligned workloads and prints one CSV row per (mode, workload, packer, phase).
+//
+// static  : insert every size once into an empty atlas.
+// dynamic : initial fill, release half of the placed rects, refill with smaller rects; packers that
+//           cannot release rects are skipped.
+//
+// Usage: allocator2d_cross_library_benchmark [output.csv] [repetitions]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "include/mo_yanxi/allocator2d.hpp"
+#include "benchmarks/reference_packers.hpp"
+
+#ifdef ALLOCATOR2D_HAVE_STB_RECT_PACK
+#define STB_RECT_PACK_IMPLEMENTATION
+#include "stb_rect_pack.h"
+#endif
+
+namespace {
+
+using mo_yanxi::math::usize2;
+using clock_type = std::chrono::steady_clock;
+
+struct Workload {
+    const char* name;
+    std::uint32_t map_size;
+    int fill_attempts;
+    std::uint32_t min_size;
+    std::uint32_t max_size;
+};
+
+constexpr Workload workloads[] = {
+    {"Standard", 2048, 10000, 32, 256},
+    {"HighFragment", 1024, 10000, 4, 16},
+    {"Aligned", 1024, 10000, 16, 16},
+};
+
+std::vector<usize2> make_sizes(const std::uint32_t min_size, const std::uint32_t max_size, const int count,
+                               const std::uint32_t seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<std::uint32_t> dist(min_size, max_size);
+    std::vector<usize2> sizes(count);
+    for (auto& size : sizes) {
+        size = {dist(rng), dist(rng)};
+    }
+    return sizes;
+}
+
+struct Placed {
+    usize2 pos;
+    usize2 size;
+};
+
+struct PhaseResult {
+    double milliseconds{};
+    std::size_t attempts{};
+    std::size_t placed{};
+    std::uint64_t used_area{};
+};
+
+struct Row {
+    const char* mode;
+    const char* workload;
+    const char* packer;
+    const char* phase;
+    PhaseResult result;
+    std::uint32_t map_size;
+};
+
+// Adapter giving allocator2d the same interface as the reference packers.
+class allocator2d_packer {
+public:
+    static constexpr bool supports_remove = true;
+    static constexpr const char* name = "allocator2d";
+
+    explicit allocator2d_packer(const usize2 extent) : alloc_(extent) {}
+
+    std::optional<usize2> insert(const usize2 size) { return alloc_.allocate(size); }
+    bool remove(const usize2 pos, const usize2) { return alloc_.deallocate(pos); }
+
+private:
+    mo_yanxi::allocator2d<> alloc_;
+};
+
+#ifdef ALLOCATOR2D_HAVE_STB_RECT_PACK
+// stb_rect_pack only packs a whole batch at once, so it takes part in the static mode only.
+PhaseResult run_stb_static(const Workload& workload, const std::vector<usize2>& sizes) {
+    std::vector<stbrp_node> nodes(workload.map_size);
+    std::vector<stbrp_rect> rects(sizes.size());
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        rects[i] = {};
+        rects[i].id = static_cast<int>(i);
+        rects[i].w = static_cast<stbrp_coord>(sizes[i].x);
+        rects[i].h = static_cast<stbrp_coord>(sizes[i].y);
+    }
+
+    const auto begin = clock_type::now();
+    stbrp_context context;
+    stbrp_init_target(&context, static_cast<int>(workload.map_size), static_cast<int>(workload.map_size),
+                      nodes.data(), static_cast<int>(nodes.size()));
+    stbrp_pack_rects(&context, rects.data(), static_cast<int>(rects.size()));
+    const auto end = clock_type::now();
+
+    PhaseResult result{std::chrono::duration<double, std::milli>(end - begin).count(), sizes.size()};
+    for (const auto& rect : rects) {
+        if (!rect.was_packed) continue;
+        ++result.placed;
+        result.used_area += static_cast<std::uint64_t>(rect.w) * rect.h;
+    }
+    return result;
+}
+#endif
+
+template <typename Packer>
+PhaseResult insert_all(Packer& packer, const std::vector<usize2>& sizes, std::vector<Placed>& placed) {
+    PhaseResult result{};
+    result.attempts = sizes.size();
+    const auto begin = clock_type::now();
+    for (const auto& size : sizes) {
+        if (const auto pos = packer.insert(size)) {
+            placed.push_back({*pos, size});
+        }
+    }
+    result.milliseconds = std::chrono::duration<double, std::milli>(clock_type::now() - begin).count();
+    return result;
+}
+
+std::uint64_t area_of(const std::vector<Placed>& placed) {
+    std::uint64_t area{};
+    for (const auto& rect : placed) area += rect.size.as<std::uint64_t>().area();
+    return area;
+}
+
+// Placement quality only means something if the packer is correct, so check every run once.
+void check_disjoint(const char* packer, const Workload& workload, const std::vector<Placed>& placed) {
+    std::vector<std::uint8_t> cells(static_cast<std::size_t>(workload.map_size) * workload.map_size);
+    for (const auto& rect : placed) {
+        if (rect.pos.x + rect.size.x > workload.map_size || rect.pos.y + rect.size.y > workload.map_size) {
+            std::cerr << packer << " placed a rect out of bounds in " << workload.name << '\n';
+            std::exit(1);
+        }
+        for (auto y = rect.pos.y; y < rect.pos.y + rect.size.y; ++y) {
+            for (auto x = rect.pos.x; x < rect.pos.x + rect.size.x; ++x) {
+                auto& cell = cells[static_cast<std::size_t>(y) * workload.map_size + x];
+                if (cell) {
+                    std::cerr << packer << " produced overlapping rects in " << workload.name << '\n';
+                    std::exit(1);
+                }
+                cell = 1;
+            }
+        }
+    }
+}
+
+// Keeps the fastest repetition; placement counts are identical between repetitions.
+void keep_best(PhaseResult& best, const PhaseResult& current, const int repetition) {
+    if (repetition == 0 || current.milliseconds < best.milliseconds) best = current;
+}
+
+template <typename Packer>
+void run_static(const Workload& workload, const std::vector<usize2>& sizes, const int repetitions, std::vector<Row>& rows) {
+    PhaseResult best{};
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        Packer packer{{workload.map_size, workload.map_size}};
+        std::vector<Placed> placed;
+        placed.reserve(sizes.size());
+        auto result = insert_all(packer, sizes, placed);
+        result.placed = placed.size();
+        result.used_area = area_of(placed);
+        if (repetition == 0) check_disjoint(Packer::name, workload, placed);
+        keep_best(best, result, repetition);
+    }
+    rows.push_back({"static", workload.name, Packer::name, "fill", best, workload.map_size});
+}
+
+template <typename Packer>
+void run_dynamic(const Workload& workload, const std::vector<usize2>& sizes, const std::vector<usize2>& refill_sizes,
+                 const int repetitions, std::vector<Row>& rows) {
+    PhaseResult fill{}, release{}, refill{};
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        Packer packer{{workload.map_size, workload.map_size}};
+        std::vector<Placed> placed;
+        placed.reserve(sizes.size() + refill_sizes.size());
+
+        auto fill_result = insert_all(packer, sizes, placed);
+        fill_result.placed = placed.size();
+        fill_result.used_area = area_of(placed);
+
+        std::mt19937 rng(42);
+        std::ranges::shuffle(placed, rng);
+        const auto release_count = placed.size() / 2;
+        PhaseResult release_result{};
+        release_result.attempts = release_count;
+        const auto begin = clock_type::now();
+        for (std::size_t i = 0; i < release_count; ++i) {
+            const auto& rect = placed[placed.size() - 1 - i];
+            release_result.placed += packer.remove(rect.pos, rect.size);
+        }
+        release_result.milliseconds = std::chrono::duration<double, std::milli>(clock_type::now() - begin).count();
+        placed.resize(placed.size() - release_count);
+        release_result.used_area = area_of(placed);
+
+        const auto kept = placed.size();
+        auto refill_result = insert_all(packer, refill_sizes, placed);
+        refill_result.placed = placed.size() - kept;
+        refill_result.used_area = area_of(placed);
+        if (repetition == 0) check_disjoint(Packer::name, workload, placed);
+
+        keep_best(fill, fill_result, repetition);
+        keep_best(release, release_result, repetition);
+        keep_best(refill, refill_result, repetition);
+    }
+    rows.push_back({"dynamic", workload.name, Packer::name, "initial_allocate", fill, workload.map_size});
+    rows.push_back({"dynamic", workload.name, Packer::name, "partial_deallocate", release, workload.map_size});
+    rows.push_back({"dynamic", workload.name, Packer::name, "refill", refill, workload.map_size});
+}
+
+// The header's static shelf packer works on whole batches; its seeding into an allocator2d is timed
+// as a separate phase.
+void run_shelf_packer_static(const Workload& workload, const std::vector<usize2>& sizes, const int repetitions,
+                             std::vector<Row>& rows) {
+    PhaseResult pack{}, seed{};
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        auto begin = clock_type::now();
+        mo_yanxi::shelf_packer<> packer{{workload.map_size, workload.map_size}};
+        const auto positions = packer.pack_all(sizes);
+        PhaseResult pack_result{std::chrono::duration<double, std::milli>(clock_type::now() - begin).count(), sizes.size()};
+
+        std::vector<Placed> placed;
+        for (std::size_t i = 0; i < sizes.size(); ++i) {
+            if (positions[i]) placed.push_back({*positions[i], sizes[i]});
+        }
+        pack_result.placed = placed.size();
+        pack_result.used_area = area_of(placed);
+        if (repetition == 0) check_disjoint("shelf_packer", workload, placed);
+
+        begin = clock_type::now();
+        const auto seeded = mo_yanxi::allocator2d<>::from_layout(packer.extent(), packer.regions());
+        PhaseResult seed_result{std::chrono::duration<double, std::milli>(clock_type::now() - begin).count(), placed.size()};
+        if (!seeded) {
+            std::cerr << "shelf_packer layout could not seed an allocator2d in " << workload.name << '\n';
+            std::exit(1);
+        }
+        seed_result.placed = placed.size();
+        seed_result.used_area = pack_result.used_area;
+
+        keep_best(pack, pack_result, repetition);
+        keep_best(seed, seed_result, repetition);
+    }
+    rows.push_back({"static", workload.name, "shelf_packer", "fill", pack, workload.map_size});
+    rows.push_back({"static", workload.name, "shelf_packer", "seed_allocator2d", seed, workload.map_size});
+}
+
+template <typename... Packers>
+void run_all(const Workload& workload, const int repetitions, std::vector<Row>& rows) {
+    const auto sizes = make_sizes(workload.min_size, workload.max_size, workload.fill_attempts, 42);
+    // smaller rects for the refill, as in the tests' fragmentation phase
+    const auto refill_sizes = make_sizes(5, workload.min_size + 5, workload.fill_attempts / 2, 1337);
+
+    (run_static<Packers>(workload, sizes, repetitions, rows), ...);
+    run_shelf_packer_static(workload, sizes, repetitions, rows);
+#ifdef ALLOCATOR2D_HAVE_STB_RECT_PACK
+    PhaseResult best{};
+    for (int repetition = 0; repetition < repetitions; ++repetition) {
+        keep_best(best, run_stb_static(workload, sizes), repetition);
+    }
+    rows.push_back({"static", workload.name, "stb_rect_pack", "fill", best, workload.map_size});
+#endif
+
+    ([&] {
+        if constexpr (Packers::supports_remove) {
+            run_dynamic<Packers>(workload, sizes, refill_sizes, repetitions, rows);
+        }
+    }(), ...);
+}
+
+void write_csv(std::ostream& out, const std::vector<Row>& rows) {
+    out << "mode,workload,packer,phase,milliseconds,attempts,placed,success_rate,occupancy,ops_per_second\n";
+    for (const auto& row : rows) {
+        const auto& result = row.result;
+        const double total_area = static_cast<double>(row.map_size) * row.map_size;
+        const double success = result.attempts ? static_cast<double>(result.placed) / result.attempts : 0.0;
+        const double ops = result.milliseconds > 0 ? result.attempts / (result.milliseconds / 1000.0) : 0.0;
+        char line[256];
+        std::snprintf(line, sizeof(line), "%s,%s,%s,%s,%.4f,%zu,%zu,%.4f,%.4f,%.0f\n", row.mode, row.workload,
+                      row.packer, row.phase, result.milliseconds, result.attempts, result.placed, success,
+                      result.used_area / total_area, ops);
+        out << line;
+    }
+}
+
+} // namespace
+
+int main(const int argc, char** argv) {
+    const int repetitions = argc > 2 ? std::max(1, std::atoi(argv[2])) : 5;
+
+    std::vector<Row> rows;
+    for (const auto& workload : workloads) {
+        run_all<allocator2d_packer, reference_packers::skyline_packer, reference_packers::guillotine_packer,
+                reference_packers::shelf_packer>(workload, repetitions, rows);
+    }
+
+    if (argc > 1) {
+        std::ofstream file{argv[1]};
+        if (!file) {
+            std::cerr << "cannot open " << argv[1] << '\n';
+            return 1;
+        }
+        write_csv(file, rows);
+    }
+    write_csv(std::cout, rows);
+    return 0;
+}
@@ -0,0 +1,216 @@
+#pragma once
+
+// Small, self-contained rectangle packers used as reference points by the cross-library benchmark.
+// They follow the textbook formulations (see Jukka Jylanki, "A Thousand Ways to Pack the Bin") and
+// favour clarity over micro-optimization, in the same way most in-engine packers are written.
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "include/mo_yanxi/allocator2d.hpp"
+
+namespace reference_packers {
+
+using mo_yanxi::math::usize2;
+
+// Next-fit shelves with first-fit reuse of open shelves.
+class shelf_packer {
+public:
+    static constexpr bool supports_remove = false;
+    static constexpr const char* name = "shelf";
+
+    explicit shelf_packer(const usize2 extent) : extent_(extent) {}
+
+    std::optional<usize2> insert(const usize2 size) {
+        for (auto& shelf : shelves_) {
+            if (size.y <= shelf.height && shelf.used + size.x <= extent_.x) {
+                const usize2 pos{shelf.used, shelf.y};
+                shelf.used += size.x;
+                return pos;
+            }
+        }
+        if (top_ + size.y > extent_.y || size.x > extent_.x) return std::nullopt;
+        shelves_.push_back({top_, size.y, size.x});
+        const usize2 pos{0, top_};
+        top_ += size.y;
+        return pos;
+    }
+
+private:
+    struct shelf {
+        std::uint32_t y;
+        std::uint32_t height;
+        std::uint32_t used;
+    };
+
+    usize2 extent_;
+    std::uint32_t top_{};
+    std::vector<shelf> shelves_{};
+};
+
+// Skyline with the bottom-left rule: lowest resulting top edge, then the leftmost position.
+class skyline_packer {
+public:
+    static constexpr bool supports_remove = false;
+    static constexpr const char* name = "skyline_bl";
+
+    explicit skyline_packer(const usize2 extent) : extent_(extent), skyline_{{0, 0, extent.x}} {}
+
+    std::optional<usize2> insert(const usize2 size) {
+        std::size_t best_index = skyline_.size();
+        std::uint32_t best_top = std::numeric_limits<std::uint32_t>::max();
+        std::uint32_t best_y = 0;
+
+        for (std::size_t i = 0; i < skyline_.size(); ++i) {
+            std::uint32_t y;
+            if (!fits(i, size, y)) continue;
+            if (y + size.y < best_top) {
+                best_top = y + size.y;
+                best_index = i;
+                best_y = y;
+            }
+        }
+        if (best_index == skyline_.size()) return std::nullopt;
+
+        const usize2 pos{skyline_[best_index].x, best_y};
+        place(best_index, {pos.x, best_top, size.x});
+        return pos;
+    }
+
+private:
+    struct segment {
+        std::uint32_t x;
+        std::uint32_t y;
+        std::uint32_t width;
+    };
+
+    bool fits(std::size_t index, const usize2 size, std::uint32_t& y) const {
+        const auto x = skyline_[index].x;
+        if (x + size.x > extent_.x) return false;
+        y = 0;
+        for (std::uint32_t remaining = size.x; remaining > 0; ++index) {
+            y = std::max(y, skyline_[index].y);
+            if (y + size.y > extent_.y) return false;
+            remaining -= std::min(remaining, skyline_[index].width);
+        }
+        return true;
+    }
+
+    void place(const std::size_t index, const segment added) {
+        skyline_.insert(skyline_.begin() + index, added);
+        const auto end = added.x + added.width;
+        for (auto i = index + 1; i < skyline_.size();) {
+            auto& next = skyline_[i];
+            if (next.x >= end) break;
+            const auto shrink = std::min(next.width, end - next.x);
+            next.x += shrink;
+            next.width -= shrink;
+            if (next.width == 0) {
+                skyline_.erase(skyline_.begin() + i);
+            } else {
+                break;
+            }
+        }
+        for (std::size_t i = 0; i + 1 < skyline_.size();) {
+            if (skyline_[i].y == skyline_[i + 1].y) {
+                skyline_[i].width += skyline_[i + 1].width;
+                skyline_.erase(skyline_.begin() + i + 1);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+    usize2 extent_;
+    std::vector<segment> skyline_;
+};
+
+// Guillotine with best-area-fit placement and the shorter-leftover-axis split rule. Released rects go
+// back to the free list and are merged with free rects sharing a full edge.
+class guillotine_packer {
+public:
+    static constexpr bool supports_remove = true;
+    static constexpr const char* name = "guillotine";
+
+    explicit guillotine_packer(const usize2 extent) : free_{{{0, 0}, extent}} {}
+
+    std::optional<usize2> insert(const usize2 size) {
+        std::size_t best = free_.size();
+        std::uint64_t best_area = std::numeric_limits<std::uint64_t>::max();
+        for (std::size_t i = 0; i < free_.size(); ++i) {
+            const auto& rect = free_[i];
+            if (size.x > rect.size.x || size.y > rect.size.y) continue;
+            const auto area = rect.size.as<std::uint64_t>().area();
+            if (area < best_area) {
+                best = i;
+                best_area = area;
+            }
+        }
+        if (best == free_.size()) return std::nullopt;
+
+        const auto chosen = free_[best];
+        free_[best] = free_.back();
+        free_.pop_back();
+
+        const auto leftover_x = chosen.size.x - size.x;
+        const auto leftover_y = chosen.size.y - size.y;
+        rect right{{chosen.pos.x + size.x, chosen.pos.y}, {leftover_x, size.y}};
+        rect top{{chosen.pos.x, chosen.pos.y + size.y}, {chosen.size.x, leftover_y}};
+        if (leftover_x >= leftover_y) {
+            // split along the shorter leftover so the longer one stays whole
+            right.size.y = chosen.size.y;
+            top.size.x = size.x;
+        }
+        if (right.size.x && right.size.y) free_.push_back(right);
+        if (top.size.x && top.size.y) free_.push_back(top);
+        return chosen.pos;
+    }
+
+    bool remove(const usize2 pos, const usize2 size) {
+        rect freed{pos, size};
+        for (bool merged = true; merged;) {
+            merged = false;
+            for (std::size_t i = 0; i < free_.size(); ++i) {
+                if (try_merge(freed, free_[i])) {
+                    free_[i] = free_.back();
+                    free_.pop_back();
+                    merged = true;
+                    break;
+                }
+            }
+        }
+        free_.push_back(freed);
+        return true;
+    }
+
+private:
+    struct rect {
+        usize2 pos;
+        usize2 size;
+    };
+
+    static bool try_merge(rect& lhs, const rect& rhs) {
+        if (lhs.pos.y == rhs.pos.y && lhs.size.y == rhs.size.y) {
+            if (lhs.pos.x + lhs.size.x == rhs.pos.x || rhs.pos.x + rhs.size.x == lhs.pos.x) {
+                lhs.pos.x = std::min(lhs.pos.x, rhs.pos.x);
+                lhs.size.x += rhs.size.x;
+                return true;
+            }
+        }
+        if (lhs.pos.x == rhs.pos.x && lhs.size.x == rhs.size.x) {
+            if (lhs.pos.y + lhs.size.y == rhs.pos.y || rhs.pos.y + rhs.size.y == lhs.pos.y) {
+                lhs.pos.y = std::min(lhs.pos.y, rhs.pos.y);
+                lhs.size.y += rhs.size.y;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<rect> free_;
+};
+
+}
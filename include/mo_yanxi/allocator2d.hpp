@@ -17,7 +17,6 @@ import std;
 #include <ranges>
 #include <map>
 #include <set>
-#include <unordered_map>
 #include <memory>
 #include <limits>
 #include <scoped_allocator>
@@ -26,6 +25,35 @@ import std;
 #include <cassert>
 #include <type_traits>
 #include <vector>
+#include <array>
+#include <bit>
+#include <span>
+#include <concepts>
+#include <functional>
+#include <coroutine>
+#include <atomic>
+#include <new>
+#include <compare>
+#include <cstring>
+#include <stdexcept>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MO_YANXI_ALLOCATOR_2D_HAS_SSE2 1
+#ifndef MO_YANXI_ALLOCATOR_2D_ENABLE_MODULE
+#include <emmintrin.h>
+#endif
+#else
+#define MO_YANXI_ALLOCATOR_2D_HAS_SSE2 0
+#endif
+
+#if defined(__AVX2__)
+#define MO_YANXI_ALLOCATOR_2D_HAS_AVX2 1
+#ifndef MO_YANXI_ALLOCATOR_2D_ENABLE_MODULE
+#include <immintrin.h>
+#endif
+#else
+#define MO_YANXI_ALLOCATOR_2D_HAS_AVX2 0
 #endif
 
 
@@ -72,11 +100,11 @@ struct vector2{
 	T y;
 
 	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE constexpr vector2 operator+(const vector2& other) const noexcept{
-		return {x + other.x, y + other.y};
+		return {static_cast<T>(x + other.x), static_cast<T>(y + other.y)};
 	}
 
 	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE constexpr vector2 operator-(const vector2& other) const noexcept{
-		return {x - other.x, y - other.y};
+		return {static_cast<T>(x - other.x), static_cast<T>(y - other.y)};
 	}
 
 	constexpr bool operator==(const vector2& other) const noexcept = default;
@@ -86,8 +114,13 @@ struct vector2{
 		return vector2<U>{static_cast<U>(x), static_cast<U>(y)};
 	}
 
+	/**
+	 * @brief Product of the coordinates, wrapping like T; area_of gives the exact 64-bit area.
+	 */
 	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE constexpr T area() const noexcept{
-		return x * y;
+		// narrow types promote to int, whose overflow would be undefined
+		using product_type = std::common_type_t<T, unsigned>;
+		return static_cast<T>(static_cast<product_type>(x) * static_cast<product_type>(y));
 	}
 
 	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE constexpr bool beyond(const vector2& other) const noexcept{
@@ -116,6 +149,15 @@ struct std::hash<mo_yanxi::math::vector2<T>>{
 
 
 namespace mo_yanxi{
+/**
+ * @brief Area of @p extent in 64 bits; the product of two coordinates overflows either coordinate type.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename T>
+MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] constexpr std::uint64_t area_of(const math::vector2<T> extent) noexcept{
+	return static_cast<std::uint64_t>(extent.x) * extent.y;
+}
+
 template <typename T>
 struct exchange_on_move{
 	T value;
@@ -147,621 +189,3509 @@ struct exchange_on_move{
 }
 
 namespace mo_yanxi{
-MO_YANXI_ALLOCATOR_2D_EXPORT
-template <typename Alloc = std::allocator<std::byte>>
-struct allocator2d{
-private:
-	using T = std::uint32_t;
-
-public:
-	using size_type = T;
-	using large_size_type = std::uint64_t;
-	using extent_type = math::vector2<T>;
-	using point_type = math::vector2<T>;
+/**
+ * @brief Open addressing table from a point to a small trivially copyable value.
+ *
+ * Points are packed into a single 64-bit key. Slots are grouped by 16 control bytes that hold 7 bits of
+ * the hash, so a probe filters a whole group at once (SSE2 when available) before touching any key.
+ */
+template <typename Point, typename Value, typename Alloc>
+struct flat_point_map{
+	static_assert(std::is_trivially_copyable_v<Value>);
+	static_assert(sizeof(Point::x) <= sizeof(std::uint32_t));
+
+	using point_type = Point;
+	using value_type = Value;
 	using allocator_type = Alloc;
 
 private:
-	using body_slot_type = size_type;
-	static constexpr body_slot_type invalid_body_slot = std::numeric_limits<body_slot_type>::max();
-
-	struct body_pool;
-	using body_pool_allocator_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<body_pool>;
-	using body_pool_allocator_traits = std::allocator_traits<body_pool_allocator_type>;
+	// both coordinates packed side by side, so 16-bit points hash as a 32-bit key
+	using key_type = std::conditional_t<sizeof(Point::x) <= sizeof(std::uint16_t), std::uint32_t, std::uint64_t>;
+	using ctrl_type = std::int8_t;
+
+	static constexpr std::size_t group_width = 16;
+	static constexpr ctrl_type ctrl_empty = -128;
+	static constexpr ctrl_type ctrl_deleted = -2;
+	static constexpr std::size_t npos = std::numeric_limits<std::size_t>::max();
+
+	template <typename V>
+	using storage_type = std::vector<V, typename std::allocator_traits<allocator_type>::template rebind_alloc<V>>;
+
+	storage_type<ctrl_type> ctrl_{};
+	storage_type<key_type> keys_{};
+	storage_type<value_type> values_{};
+	exchange_on_move<std::size_t> size_{};
+	exchange_on_move<std::size_t> tombstones_{};
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static key_type pack_(const point_type point) noexcept{
+		return static_cast<key_type>(point.x) | static_cast<key_type>(point.y) << std::numeric_limits<key_type>::digits / 2;
+	}
 
-	struct body_pool_deleter{
-		void operator()(body_pool* pool) const noexcept;
-	};
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static std::uint64_t hash_(const key_type key) noexcept{
+		std::uint64_t h = key * 0x9e3779b97f4a7c15ull;
+		return h ^ (h >> 29);
+	}
 
-	using body_pool_owner_type = std::unique_ptr<body_pool, body_pool_deleter>;
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static ctrl_type h2_(const std::uint64_t hash) noexcept{
+		return static_cast<ctrl_type>(hash & 0x7f);
+	}
 
-	MO_YANXI_ALLOCATOR_2D_NO_UNIQUE_ADDRESS allocator_type allocator_{};
-	exchange_on_move<extent_type> extent_{};
-	exchange_on_move<large_size_type> remain_area_{};
-	exchange_on_move<large_size_type> fragment_threshold_{};
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] std::size_t group_mask_() const noexcept{
+		return ctrl_.size() / group_width - 1;
+	}
 
-	struct split_point;
+	/**
+	 * @brief Bitmask of the slots in the group starting at @p ctrl whose control byte equals @p tag.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static std::uint32_t match_(const ctrl_type* ctrl, const ctrl_type tag) noexcept{
+#if MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+		const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+		return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(tag))));
+#else
+		std::uint32_t mask = 0;
+		for(std::size_t i = 0; i < group_width; ++i){
+			mask |= static_cast<std::uint32_t>(ctrl[i] == tag) << i;
+		}
+		return mask;
+#endif
+	}
 
-	body_pool& ensure_body_pool_();
-	[[nodiscard]] allocator2d& body_allocator_at_(body_slot_type slot);
-	[[nodiscard]] const allocator2d& body_allocator_at_(body_slot_type slot) const;
-	[[nodiscard]] body_slot_type acquire_body_slot_();
-	void release_body_slot_(body_slot_type slot) noexcept;
-	[[nodiscard]] allocator2d& create_body_allocator_(split_point& node);
-	void destroy_body_allocator_(split_point& node) noexcept;
-
-	struct allocation_record{
-		point_type owner_point{};
-		point_type nested_point{};
-		extent_type extent{};
-		bool nested{};
-	};
+	/**
+	 * @brief Bitmask of the empty or deleted slots in the group starting at @p ctrl.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static std::uint32_t match_vacant_(const ctrl_type* ctrl) noexcept{
+#if MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+		// only the vacant tags have their sign bit set
+		const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+		return static_cast<std::uint32_t>(_mm_movemask_epi8(group));
+#else
+		std::uint32_t mask = 0;
+		for(std::size_t i = 0; i < group_width; ++i){
+			mask |= static_cast<std::uint32_t>(ctrl[i] < 0) << i;
+		}
+		return mask;
+#endif
+	}
 
-	using map_type = std::unordered_map<
-		point_type, split_point,
-		std::hash<point_type>, std::equal_to<point_type>,
-		typename std::allocator_traits<allocator_type>::template rebind_alloc<std::pair<
-			const point_type, split_point>>
-	>;
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static int next_bit_(std::uint32_t& mask) noexcept{
+		const int bit = std::countr_zero(mask);
+		mask &= mask - 1;
+		return bit;
+	}
 
-	using allocation_map_type = std::unordered_map<
-		point_type, allocation_record,
-		std::hash<point_type>, std::equal_to<point_type>,
-		typename std::allocator_traits<allocator_type>::template rebind_alloc<std::pair<
-			const point_type, allocation_record>>
-	>;
+	[[nodiscard]] std::size_t find_slot_(const key_type key) const noexcept{
+		if(ctrl_.empty()) return npos;
+		const auto hash = hash_(key);
+		const auto tag = h2_(hash);
+		const auto mask = group_mask_();
+
+		auto group = static_cast<std::size_t>(hash >> 7) & mask;
+		for(std::size_t step = 1;; ++step){
+			const auto* ctrl = ctrl_.data() + group * group_width;
+			for(auto hits = match_(ctrl, tag); hits;){
+				const auto slot = group * group_width + next_bit_(hits);
+				if(keys_[slot] == key) return slot;
+			}
+			if(match_(ctrl, ctrl_empty)) return npos;
+			group = (group + step) & mask;
+		}
+	}
 
-	struct free_entry{
-		size_type major{};
-		size_type minor{};
-		point_type point{};
-	};
+	[[nodiscard]] std::size_t find_vacant_(const std::uint64_t hash) const noexcept{
+		const auto mask = group_mask_();
+		auto group = static_cast<std::size_t>(hash >> 7) & mask;
+		for(std::size_t step = 1;; ++step){
+			if(auto vacant = match_vacant_(ctrl_.data() + group * group_width)){
+				return group * group_width + next_bit_(vacant);
+			}
+			group = (group + step) & mask;
+		}
+	}
 
-	struct free_entry_compare{
-		bool operator()(const free_entry& lhs, const free_entry& rhs) const noexcept{
-			if(lhs.major != rhs.major) return lhs.major < rhs.major;
-			if(lhs.minor != rhs.minor) return lhs.minor < rhs.minor;
-			if(lhs.point.y != rhs.point.y) return lhs.point.y < rhs.point.y;
-			return lhs.point.x < rhs.point.x;
+	void rehash_(const std::size_t capacity){
+		auto old_ctrl = std::move(ctrl_);
+		auto old_keys = std::move(keys_);
+		auto old_values = std::move(values_);
+
+		ctrl_ = storage_type<ctrl_type>(old_ctrl.get_allocator());
+		keys_ = storage_type<key_type>(old_keys.get_allocator());
+		values_ = storage_type<value_type>(old_values.get_allocator());
+		ctrl_.assign(capacity, ctrl_empty);
+		keys_.resize(capacity);
+		values_.resize(capacity);
+		tombstones_ = 0;
+
+		for(std::size_t i = 0; i < old_ctrl.size(); ++i){
+			if(old_ctrl[i] < 0) continue;
+			const auto hash = hash_(old_keys[i]);
+			const auto slot = find_vacant_(hash);
+			ctrl_[slot] = h2_(hash);
+			keys_[slot] = old_keys[i];
+			values_[slot] = old_values[i];
 		}
-	};
+	}
 
-	using free_tree_type = std::multiset<
-		free_entry,
-		free_entry_compare,
-		typename std::allocator_traits<allocator_type>::template rebind_alloc<free_entry>
-	>;
+	[[nodiscard]] static constexpr std::size_t capacity_for_(const std::size_t count) noexcept{
+		// keep the load factor at or below 7/8
+		std::size_t capacity = group_width;
+		while(capacity / 8 * 7 < count) capacity *= 2;
+		return capacity;
+	}
 
-	using index_handle = typename free_tree_type::iterator;
+	/**
+	 * @brief Rehash in place to clear the tombstones, without allocating.
+	 *
+	 * Live slots are first tagged deleted and tombstones emptied. Each tagged key then either stays in its
+	 * group, moves to an empty slot earlier on its probe sequence, or swaps with a tagged key there that is
+	 * handled next; a key never lands behind an empty slot of its own probe sequence.
+	 */
+	void drop_tombstones_() noexcept{
+		for(auto& ctrl : ctrl_){
+			ctrl = ctrl == ctrl_deleted ? ctrl_empty : ctrl >= 0 ? ctrl_deleted : ctrl;
+		}
 
-	struct region_index{
-		free_tree_type xy{};
-		free_tree_type yx{};
+		for(std::size_t slot = 0; slot < ctrl_.size();){
+			if(ctrl_[slot] != ctrl_deleted){
+				++slot;
+				continue;
+			}
 
-		region_index() = default;
+			const auto hash = hash_(keys_[slot]);
+			const auto target = find_vacant_(hash);
+			if(target / group_width == slot / group_width){
+				ctrl_[slot] = h2_(hash);
+				++slot;
+			} else if(ctrl_[target] == ctrl_empty){
+				ctrl_[target] = h2_(hash);
+				keys_[target] = keys_[slot];
+				values_[target] = values_[slot];
+				ctrl_[slot] = ctrl_empty;
+				++slot;
+			} else{
+				// the displaced key now sits at slot and is placed on the next pass
+				ctrl_[target] = h2_(hash);
+				std::swap(keys_[target], keys_[slot]);
+				std::swap(values_[target], values_[slot]);
+			}
+		}
+		tombstones_ = 0;
+	}
 
-		explicit region_index(const allocator_type& allocator)
-			: xy(typename free_tree_type::allocator_type{allocator}),
-			  yx(typename free_tree_type::allocator_type{allocator}){
+	void grow_for_insert_(){
+		if((size_.value + tombstones_.value + 1) <= ctrl_.size() / 8 * 7) return;
+		// never shrink, so a reserved table keeps its storage once tombstones pile up
+		if(const auto capacity = capacity_for_((size_.value + 1) * 2); capacity > ctrl_.size()){
+			rehash_(capacity);
+		} else{
+			drop_tombstones_();
 		}
-	};
+	}
 
-	using body_nodes_type = std::vector<
-		point_type,
-		typename std::allocator_traits<allocator_type>::template rebind_alloc<point_type>>;
+public:
+	[[nodiscard]] flat_point_map() = default;
 
-	struct split_point{
-		point_type parent{};
-		point_type bot_lft{};
-		point_type top_rit{};
-		point_type split{top_rit};
+	[[nodiscard]] explicit flat_point_map(const allocator_type& allocator)
+		: ctrl_(allocator), keys_(allocator), values_(allocator){
+	}
 
-		bool idle{true};
-		bool idle_top{true};
-		bool idle_right{true};
-		bool in_free_tree{false};
-		bool in_fragment_tree{false};
-		bool wide_top_split{false};
-		bool is_top_child{false};
+	[[nodiscard]] value_type* find(const point_type point) noexcept{
+		const auto slot = find_slot_(pack_(point));
+		return slot == npos ? nullptr : &values_[slot];
+	}
 
-		body_slot_type body_slot{invalid_body_slot};
+	[[nodiscard]] const value_type* find(const point_type point) const noexcept{
+		const auto slot = find_slot_(pack_(point));
+		return slot == npos ? nullptr : &values_[slot];
+	}
 
-		index_handle free_xy{};
-		index_handle free_yx{};
+	void insert_or_assign(const point_type point, const value_type value){
+		const auto key = pack_(point);
+		if(const auto slot = find_slot_(key); slot != npos){
+			values_[slot] = value;
+			return;
+		}
 
-		[[nodiscard]] split_point() = default;
+		grow_for_insert_();
+		const auto hash = hash_(key);
+		const auto slot = find_vacant_(hash);
+		if(ctrl_[slot] == ctrl_deleted) --tombstones_.value;
+		ctrl_[slot] = h2_(hash);
+		keys_[slot] = key;
+		values_[slot] = value;
+		++size_.value;
+	}
 
-		[[nodiscard]] split_point(
-			const point_type parent,
-			const point_type bot_lft,
-			const point_type top_rit)
-			: parent(parent), bot_lft(bot_lft), top_rit(top_rit){
-		}
+	bool erase(const point_type point) noexcept{
+		const auto slot = find_slot_(pack_(point));
+		if(slot == npos) return false;
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool is_leaf() const noexcept{
-			return split == top_rit;
+		// a group that still has an empty slot never continues a probe sequence
+		const auto* group = ctrl_.data() + slot / group_width * group_width;
+		if(match_(group, ctrl_empty)){
+			ctrl_[slot] = ctrl_empty;
+		} else{
+			ctrl_[slot] = ctrl_deleted;
+			++tombstones_.value;
 		}
+		--size_.value;
+		return true;
+	}
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool is_split_idle() const noexcept{
-			return idle_top && idle_right;
-		}
+	void reserve(const std::size_t count){
+		const auto capacity = capacity_for_(count);
+		if(capacity > ctrl_.size()) rehash_(capacity);
+	}
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] extent_type body_extent() const noexcept{
-			return split - bot_lft;
-		}
+	void clear() noexcept{
+		std::ranges::fill(ctrl_, ctrl_empty);
+		size_ = 0;
+		tombstones_ = 0;
+	}
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void clear_free_tree_state() noexcept{
-			in_free_tree = false;
-		}
+	[[nodiscard]] std::size_t size() const noexcept{ return size_.value; }
+	[[nodiscard]] std::size_t capacity() const noexcept{ return ctrl_.size(); }
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool prefer_wide_top_split(const extent_type extent) const noexcept{
-			const auto remain_x = top_rit.x - (bot_lft.x + extent.x);
-			const auto remain_y = top_rit.y - (bot_lft.y + extent.y);
-			return remain_x < remain_y;
-		}
+	[[nodiscard]] std::size_t memory_usage() const noexcept{
+		return ctrl_.capacity() * sizeof(ctrl_type) + keys_.capacity() * sizeof(key_type)
+			+ values_.capacity() * sizeof(value_type);
+	}
+};
+}
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type top_region_src() const noexcept{
-			return {bot_lft.x, split.y};
-		}
+namespace mo_yanxi{
+/**
+ * @brief Pointer stored as its distance from its own address, so a structure linked with it stays valid
+ * wherever its memory is mapped.
+ *
+ * Copies recompute the distance for their new address; a byte copy of a whole mapped block keeps every
+ * pointer inside the block valid, which is what a second process mapping the block at another address sees.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename T>
+class offset_ptr{
+	// no object starts one byte past the pointer itself, so 1 marks null
+	static constexpr std::ptrdiff_t null_offset = 1;
+	std::ptrdiff_t offset_{null_offset};
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type top_region_end() const noexcept{
-			if(wide_top_split) return top_rit;
-			return {split.x, top_rit.y};
-		}
+	template <typename U>
+	friend class offset_ptr;
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type right_region_src() const noexcept{
-			return {split.x, bot_lft.y};
-		}
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void set_(const void* pointer) noexcept{
+		offset_ = pointer == nullptr
+			? null_offset
+			: static_cast<std::ptrdiff_t>(reinterpret_cast<std::uintptr_t>(pointer) - reinterpret_cast<std::uintptr_t>(this));
+	}
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type right_region_end() const noexcept{
-			if(wide_top_split) return {top_rit.x, split.y};
-			return top_rit;
-		}
+public:
+	using element_type = T;
+	using value_type = std::remove_cv_t<T>;
+	using difference_type = std::ptrdiff_t;
+	using pointer = offset_ptr;
+	using reference = std::add_lvalue_reference_t<T>;
+	using iterator_category = std::random_access_iterator_tag;
+	using iterator_concept = std::contiguous_iterator_tag;
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void mark_captured(allocator2d& alloc) noexcept{
-			idle = false;
+	template <typename U>
+	using rebind = offset_ptr<U>;
 
-			split_point* cur = this;
-			while(auto* parent = alloc.parent_node_of_(*cur)){
-				if(cur->is_top_child){
-					parent->idle_top = false;
-				} else{
-					parent->idle_right = false;
-				}
-				cur = parent;
-			}
-		}
+	[[nodiscard]] offset_ptr() noexcept = default;
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE allocator2d& ensure_body_allocator(allocator2d& alloc){
-			assert(!is_leaf());
-			if(body_slot == invalid_body_slot){
-				alloc.erase_mark_(bot_lft, split);
-				return alloc.create_body_allocator_(*this);
-			}
-			return alloc.body_allocator_at_(body_slot);
-		}
+	[[nodiscard]] offset_ptr(std::nullptr_t) noexcept{
+	}
 
-		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void release_body_allocator(allocator2d& alloc) noexcept{
-			if(body_slot == invalid_body_slot) return;
-			alloc.destroy_body_allocator_(*this);
-		}
+	[[nodiscard]] offset_ptr(T* pointer) noexcept{
+		set_(pointer);
+	}
 
-		bool check_merge(allocator2d& alloc) noexcept{
-			if(idle && is_split_idle()){
-				if(body_slot != invalid_body_slot){
-					assert(alloc.body_allocator_at_(body_slot).remain_area() == body_extent().template as<large_size_type>().area());
-					this->release_body_allocator(alloc);
-				}
+	[[nodiscard]] offset_ptr(const offset_ptr& other) noexcept{
+		set_(other.get());
+	}
 
-				const point_type top_src = top_region_src();
-				const point_type top_end = top_region_end();
-				if((top_end - top_src).area() > 0) alloc.erase_split_(top_src, top_end);
+	template <typename U>
+		requires (std::convertible_to<U*, T*>)
+	[[nodiscard]] offset_ptr(const offset_ptr<U>& other) noexcept{
+		set_(static_cast<T*>(other.get()));
+	}
 
-				const point_type right_src = right_region_src();
-				const point_type right_end = right_region_end();
-				if((right_end - right_src).area() > 0) alloc.erase_split_(right_src, right_end);
+	template <typename U>
+		requires (!std::convertible_to<U*, T*> && requires(U* pointer){ static_cast<T*>(pointer); })
+	[[nodiscard]] explicit offset_ptr(const offset_ptr<U>& other) noexcept{
+		set_(static_cast<T*>(other.get()));
+	}
 
-				alloc.erase_mark_(bot_lft, split);
-				split = top_rit;
-				idle_top = true;
-				idle_right = true;
+	offset_ptr& operator=(const offset_ptr& other) noexcept{
+		set_(other.get());
+		return *this;
+	}
 
-				if(auto* parent = alloc.parent_node_of_(*this); parent != nullptr){
-					if(is_top_child){
-						parent->idle_top = true;
-					} else{
-						parent->idle_right = true;
-					}
-					return true;
-				}
-				return false;
-			}
-			return false;
-		}
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] T* get() const noexcept{
+		if(offset_ == null_offset) return nullptr;
+		return reinterpret_cast<T*>(reinterpret_cast<std::uintptr_t>(this) + static_cast<std::uintptr_t>(offset_));
+	}
 
-		void acquire_and_split(allocator2d& alloc, const extent_type extent){
-			assert(idle);
-			assert(is_leaf());
+	template <typename U = T>
+		requires (!std::is_void_v<U>)
+	[[nodiscard]] static offset_ptr pointer_to(U& value) noexcept{
+		return offset_ptr{std::addressof(value)};
+	}
 
-			split = bot_lft + extent;
-			wide_top_split = prefer_wide_top_split(extent);
+	[[nodiscard]] explicit operator bool() const noexcept{
+		return offset_ != null_offset;
+	}
 
-			alloc.erase_mark_(bot_lft, top_rit);
+	[[nodiscard]] reference operator*() const noexcept requires (!std::is_void_v<T>){
+		return *get();
+	}
 
-			const point_type right_src = right_region_src();
-			const point_type right_end = right_region_end();
-			if((right_end - right_src).area() > 0){
-				alloc.add_split_(bot_lft, right_src, right_end);
-			}
+	[[nodiscard]] T* operator->() const noexcept{
+		return get();
+	}
 
-			const point_type top_src = top_region_src();
-			const point_type top_end = top_region_end();
-			if((top_end - top_src).area() > 0){
-				alloc.add_split_(bot_lft, top_src, top_end);
-			}
+	[[nodiscard]] reference operator[](const difference_type index) const noexcept requires (!std::is_void_v<T>){
+		return get()[index];
+	}
 
-			mark_captured(alloc);
-			clear_free_tree_state();
-		}
+	offset_ptr& operator+=(const difference_type count) noexcept requires (!std::is_void_v<T>){
+		set_(get() + count);
+		return *this;
+	}
 
-		split_point* mark_idle(allocator2d& alloc) noexcept{
-			assert(!idle);
-			idle = true;
-			split_point* p = this;
-			split_point* last = this;
-			while(p->check_merge(alloc)){
-				auto* next = alloc.parent_node_of_(*p);
-				assert(next != nullptr);
-				last = p;
-				p = next;
-			}
+	offset_ptr& operator-=(const difference_type count) noexcept requires (!std::is_void_v<T>){
+		set_(get() - count);
+		return *this;
+	}
 
-			if(p->is_leaf()){
-				alloc.mark_size_(p->bot_lft, p->split);
-			} else{
-				alloc.mark_size_(last->bot_lft, last->split);
-			}
-			return p;
-		}
+	offset_ptr& operator++() noexcept requires (!std::is_void_v<T>){
+		return *this += 1;
+	}
 
-		void mark_body_idle(allocator2d& alloc) noexcept{
-			idle = true;
-			split_point* p = this;
-			split_point* last = this;
-			while(p->check_merge(alloc)){
-				auto* next = alloc.parent_node_of_(*p);
-				assert(next != nullptr);
-				last = p;
-				p = next;
-			}
+	offset_ptr& operator--() noexcept requires (!std::is_void_v<T>){
+		return *this -= 1;
+	}
 
-			if(p == this && !p->is_leaf()) return;
-			if(p->is_leaf()){
-				alloc.mark_size_(p->bot_lft, p->split);
-			} else{
-				alloc.mark_size_(last->bot_lft, last->split);
-			}
-		}
-	};
+	offset_ptr operator++(int) noexcept requires (!std::is_void_v<T>){
+		offset_ptr result{*this};
+		++*this;
+		return result;
+	}
 
-	struct node_choice{
-		std::optional<point_type> point{};
-		extent_type extent{};
-		large_size_type area{std::numeric_limits<large_size_type>::max()};
-		size_type max_slack{std::numeric_limits<size_type>::max()};
-		size_type min_slack{std::numeric_limits<size_type>::max()};
-		split_point* nested_owner{};
-		point_type nested_point{};
-	};
+	offset_ptr operator--(int) noexcept requires (!std::is_void_v<T>){
+		offset_ptr result{*this};
+		--*this;
+		return result;
+	}
 
-	map_type map_{};
-	allocation_map_type allocations_{};
-	region_index large_nodes_{};
-	region_index frag_nodes_{};
-	body_nodes_type body_nodes_{};
-	body_pool_owner_type body_pool_owner_{};
+	[[nodiscard]] friend offset_ptr operator+(const offset_ptr& pointer, const difference_type count) noexcept requires (!std::is_void_v<T>){
+		return offset_ptr{pointer.get() + count};
+	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static bool better_choice_(const node_choice& lhs, const node_choice& rhs) noexcept{
-		if(!lhs.point) return false;
-		if(!rhs.point) return true;
-		if(lhs.area != rhs.area) return lhs.area < rhs.area;
-		if(lhs.max_slack != rhs.max_slack) return lhs.max_slack < rhs.max_slack;
-		if(lhs.min_slack != rhs.min_slack) return lhs.min_slack < rhs.min_slack;
-		return lhs.point.value() == rhs.point.value()
-			       ? false
-			       : lhs.point.value().y < rhs.point.value().y ||
-			       (lhs.point.value().y == rhs.point.value().y && lhs.point.value().x < rhs.point.value().x);
+	[[nodiscard]] friend offset_ptr operator+(const difference_type count, const offset_ptr& pointer) noexcept requires (!std::is_void_v<T>){
+		return offset_ptr{pointer.get() + count};
 	}
 
-	template <bool outer_is_x>
-	node_choice find_best_node_in_tree_(free_tree_type& tree, const extent_type size){
-		node_choice best{};
-		const auto outer_need = outer_is_x ? size.x : size.y;
+	[[nodiscard]] friend offset_ptr operator-(const offset_ptr& pointer, const difference_type count) noexcept requires (!std::is_void_v<T>){
+		return offset_ptr{pointer.get() - count};
+	}
+
+	[[nodiscard]] friend difference_type operator-(const offset_ptr& lhs, const offset_ptr& rhs) noexcept requires (!std::is_void_v<T>){
+		return lhs.get() - rhs.get();
+	}
+
+	[[nodiscard]] friend bool operator==(const offset_ptr& lhs, const offset_ptr& rhs) noexcept{
+		return lhs.get() == rhs.get();
+	}
+
+	[[nodiscard]] friend bool operator==(const offset_ptr& lhs, std::nullptr_t) noexcept{
+		return !lhs;
+	}
+
+	[[nodiscard]] friend std::strong_ordering operator<=>(const offset_ptr& lhs, const offset_ptr& rhs) noexcept{
+		return std::compare_three_way{}(lhs.get(), rhs.get());
+	}
+};
+
+/**
+ * @brief Fixed-capacity arena at the start of a caller-provided block, such as a shared memory mapping.
+ *
+ * The header and every free list refer to memory by offset from the arena, so each process may map the
+ * block at its own address. Blocks come in power-of-two size classes and are recycled per class without
+ * coalescing, which suits the doubling growth of the allocator's arrays. The arena is not synchronized:
+ * guard it with the same lock as the allocator placed in it, e.g. a shared_spin_lock.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+class alignas(std::max_align_t) shared_arena{
+	static constexpr std::size_t min_class = 4;
+	static constexpr std::size_t class_count = std::numeric_limits<std::size_t>::digits;
+	static constexpr std::size_t no_block = 0;
+
+	std::size_t size_{};
+	std::size_t top_{};
+	/**
+	 * @brief Offset of the first free block of each size class; a free block holds the offset of the next one.
+	 */
+	std::array<std::size_t, class_count> free_{};
+	offset_ptr<void> root_{};
+
+	[[nodiscard]] std::byte* base_() noexcept{
+		return reinterpret_cast<std::byte*>(this);
+	}
+
+	[[nodiscard]] static std::size_t class_of_(const std::size_t bytes) noexcept{
+		return std::max<std::size_t>(min_class, std::bit_width(std::max<std::size_t>(bytes, 1) - 1));
+	}
+
+	explicit shared_arena(const std::size_t size) noexcept
+		: size_(size), top_(sizeof(shared_arena)){
+	}
+
+public:
+	shared_arena(const shared_arena&) = delete;
+	shared_arena& operator=(const shared_arena&) = delete;
+
+	/**
+	 * @brief Start an empty arena over the @p bytes bytes at @p memory, which must be aligned for std::max_align_t.
+	 */
+	[[nodiscard]] static shared_arena* create(void* memory, const std::size_t bytes) noexcept{
+		assert(reinterpret_cast<std::uintptr_t>(memory) % alignof(shared_arena) == 0);
+		assert(bytes >= sizeof(shared_arena));
+		return ::new(memory) shared_arena{bytes};
+	}
+
+	/**
+	 * @brief The arena created at @p memory, possibly by another process mapping the same block elsewhere.
+	 */
+	[[nodiscard]] static shared_arena* attach(void* memory) noexcept{
+		return std::launder(static_cast<shared_arena*>(memory));
+	}
+
+	/**
+	 * @throw std::bad_alloc when the arena is exhausted or @p alignment exceeds std::max_align_t.
+	 */
+	[[nodiscard]] void* allocate(const std::size_t bytes, const std::size_t alignment = alignof(std::max_align_t)){
+		const auto size_class = class_of_(bytes);
+		if(alignment > alignof(std::max_align_t) || size_class >= class_count) throw std::bad_alloc{};
+
+		if(const auto block = free_[size_class]; block != no_block){
+			std::memcpy(&free_[size_class], base_() + block, sizeof(std::size_t));
+			return base_() + block;
+		}
+
+		const auto block_size = std::size_t{1} << size_class;
+		if(block_size > size_ - top_) throw std::bad_alloc{};
+		const auto block = top_;
+		// block sizes are multiples of the alignment, so the top stays aligned
+		top_ += std::max(block_size, alignof(std::max_align_t));
+		return base_() + block;
+	}
+
+	void deallocate(void* pointer, const std::size_t bytes) noexcept{
+		if(pointer == nullptr) return;
+		const auto size_class = class_of_(bytes);
+		const auto block = static_cast<std::size_t>(static_cast<std::byte*>(pointer) - base_());
+		std::memcpy(pointer, &free_[size_class], sizeof(std::size_t));
+		free_[size_class] = block;
+	}
+
+	/**
+	 * @brief Object the processes sharing the arena find each other's state through, e.g. the allocator.
+	 */
+	void set_root(void* root) noexcept{
+		root_ = root;
+	}
+
+	[[nodiscard]] void* root() const noexcept{
+		return root_.get();
+	}
+
+	/**
+	 * @brief Bytes taken from the block so far, including the header and recycled blocks.
+	 */
+	[[nodiscard]] std::size_t used() const noexcept{
+		return top_;
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept{
+		return size_;
+	}
+};
+
+/**
+ * @brief Allocator drawing from a shared_arena through offset pointers.
+ *
+ * Its pointer type is offset_ptr, which is what switches allocator2d to the position independent layout
+ * described there.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename T>
+struct arena_allocator{
+	using value_type = T;
+	using pointer = offset_ptr<T>;
+	using const_pointer = offset_ptr<const T>;
+	using void_pointer = offset_ptr<void>;
+	using const_void_pointer = offset_ptr<const void>;
+	using propagate_on_container_copy_assignment = std::true_type;
+	using propagate_on_container_move_assignment = std::true_type;
+	using propagate_on_container_swap = std::true_type;
+	using is_always_equal = std::false_type;
+
+	offset_ptr<shared_arena> arena{};
+
+	[[nodiscard]] explicit arena_allocator(shared_arena& arena) noexcept
+		: arena(&arena){
+	}
+
+	template <typename U>
+	[[nodiscard]] arena_allocator(const arena_allocator<U>& other) noexcept
+		: arena(other.arena){
+	}
+
+	[[nodiscard]] pointer allocate(const std::size_t count){
+		if(count > std::numeric_limits<std::size_t>::max() / sizeof(T)) throw std::bad_alloc{};
+		return pointer{static_cast<T*>(arena->allocate(count * sizeof(T), alignof(T)))};
+	}
+
+	void deallocate(const pointer pointer, const std::size_t count) noexcept{
+		arena->deallocate(pointer.get(), count * sizeof(T));
+	}
+
+	template <typename U>
+	[[nodiscard]] bool operator==(const arena_allocator<U>& other) const noexcept{
+		return arena.get() == other.arena.get();
+	}
+};
+
+/**
+ * @brief Spin lock that works across processes when placed in shared memory, since lock-free atomics do not
+ * depend on the address they are mapped at.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+class shared_spin_lock{
+	static_assert(std::atomic<std::uint32_t>::is_always_lock_free);
+	std::atomic<std::uint32_t> locked_{};
+
+public:
+	[[nodiscard]] bool try_lock() noexcept{
+		return !locked_.load(std::memory_order_relaxed) && !locked_.exchange(1, std::memory_order_acquire);
+	}
+
+	void lock() noexcept{
+		while(!try_lock()){
+			while(locked_.load(std::memory_order_relaxed)){
+#if MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+				_mm_pause();
+#endif
+			}
+		}
+	}
+
+	void unlock() noexcept{
+		locked_.store(0, std::memory_order_release);
+	}
+};
+}
+
+namespace mo_yanxi{
+/**
+ * @brief Two-dimensional region allocator over a guillotine split tree.
+ *
+ * @tparam T coordinate type, 16 or 32-bit unsigned. 16-bit coordinates limit the extent to 65535 per axis
+ * and halve the points held by nodes, free indexes and the point map.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename Alloc = std::allocator<std::byte>, typename T = std::uint32_t>
+struct allocator2d{
+	static_assert(std::same_as<T, std::uint16_t> || std::same_as<T, std::uint32_t>);
+
+	using size_type = T;
+	using large_size_type = std::uint64_t;
+	using extent_type = math::vector2<T>;
+	using point_type = math::vector2<T>;
+	using allocator_type = Alloc;
+
+	/**
+	 * @brief Whether the allocator hands out fancy pointers such as offset_ptr, e.g. arena_allocator.
+	 *
+	 * The state then holds no raw address and may live in memory mapped by several processes: the sorted
+	 * large-region index, whose tree nodes link by address, is left out and every free region goes to the
+	 * array-based fragment index, which picks the same best fit. allocate_async is unavailable, since its
+	 * awaiters belong to one process.
+	 */
+	static constexpr bool position_independent = !std::is_pointer_v<typename std::allocator_traits<Alloc>::pointer>;
+
+	/**
+	 * @brief Approximate bytes held by the internal bookkeeping.
+	 *
+	 * Node-based standard containers do not expose their node layout, so per-entry costs are estimated
+	 * from the usual link/hash overhead of the common implementations.
+	 */
+	struct memory_usage_report{
+		std::size_t nodes{};
+		std::size_t node_map{};
+		std::size_t region_indexes{};
+
+		[[nodiscard]] constexpr std::size_t total() const noexcept{
+			return nodes + node_map + region_indexes;
+		}
+	};
+
+	/**
+	 * @brief Axis-aligned rectangle given by its bottom-left point and extent.
+	 */
+	struct region{
+		point_type src{};
+		extent_type extent{};
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] constexpr point_type end() const noexcept{
+			return src + extent;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] constexpr bool contains(const region& other) const noexcept{
+			const auto self_end = end();
+			const auto other_end = other.end();
+			return src.x <= other.src.x && src.y <= other.src.y && other_end.x <= self_end.x && other_end.y <= self_end.y;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] constexpr bool overlaps(const region& other) const noexcept{
+			const auto self_end = end();
+			const auto other_end = other.end();
+			return src.x < other_end.x && other.src.x < self_end.x && src.y < other_end.y && other.src.y < self_end.y;
+		}
+
+		constexpr bool operator==(const region& other) const noexcept = default;
+	};
+
+	using region_list_type = std::vector<
+		region,
+		typename std::allocator_traits<Alloc>::template rebind_alloc<region>>;
+
+	/**
+	 * @brief Result of allocate_handle, naming the node that owns the allocation.
+	 *
+	 * Stays valid until the allocation is released; a released handle is rejected as long as its node
+	 * has not been reused for an allocation at the same point.
+	 */
+	struct allocation_handle{
+		point_type point{};
+		std::uint32_t node{};
+
+		[[nodiscard]] constexpr allocation_handle() = default;
+
+		// not an aggregate, so that deallocate({x, y}) keeps resolving to the point overload
+		[[nodiscard]] constexpr allocation_handle(const point_type point, const std::uint32_t node) noexcept
+			: point(point), node(node){
+		}
+
+		constexpr bool operator==(const allocation_handle& other) const noexcept = default;
+	};
+
+	/**
+	 * @brief Result of allocate_rotatable.
+	 */
+	struct rotatable_allocation{
+		point_type point{};
+		/**
+		 * @brief The allocation occupies {extent.y, extent.x} instead of the requested extent.
+		 */
+		bool rotated{};
+	};
+
+private:
+	struct waiter_index;
+
+public:
+	/**
+	 * @brief Awaitable returned by allocate_async, resuming with the allocated point.
+	 *
+	 * A request that does not fit right away is parked in the allocator until a release frees a region
+	 * that can hold it. Destroying the awaiting coroutine while it is parked withdraws the request.
+	 */
+	class allocation_awaiter{
+		friend allocator2d;
+
+		allocator2d* owner_;
+		extent_type extent_;
+		std::optional<point_type> point_{};
+		std::coroutine_handle<> continuation_{};
+		/**
+		 * @brief Index holding the request while parked, null otherwise.
+		 */
+		waiter_index* index_{};
+		allocation_awaiter* prev_{};
+		allocation_awaiter* next_{};
+
+		[[nodiscard]] allocation_awaiter(allocator2d& owner, const extent_type extent) noexcept
+			: owner_(&owner), extent_(extent){
+		}
+
+	public:
+		allocation_awaiter(const allocation_awaiter&) = delete;
+		allocation_awaiter& operator=(const allocation_awaiter&) = delete;
+
+		~allocation_awaiter(){
+			if(index_) index_->erase(*this);
+		}
+
+		[[nodiscard]] bool await_ready(){
+			if(area_of(extent_) == 0) return true;
+			point_ = owner_->allocate(extent_);
+			return point_.has_value();
+		}
+
+		void await_suspend(const std::coroutine_handle<> continuation) noexcept{
+			continuation_ = continuation;
+			owner_->waiters_.push(*this);
+		}
+
+		/**
+		 * @return nullopt if the extent is empty or the request was cancelled by cancel_waiters.
+		 */
+		[[nodiscard]] std::optional<point_type> await_resume() const noexcept{
+			return point_;
+		}
+	};
+
+private:
+	// node counts are not bounded by the coordinate range
+	using node_index = std::uint32_t;
+	static constexpr node_index invalid_node = std::numeric_limits<node_index>::max();
+
+	MO_YANXI_ALLOCATOR_2D_NO_UNIQUE_ADDRESS allocator_type allocator_{};
+	exchange_on_move<extent_type> extent_{};
+	exchange_on_move<large_size_type> remain_area_{};
+	exchange_on_move<large_size_type> fragment_threshold_{};
+	exchange_on_move<node_index> free_node_{invalid_node};
+	exchange_on_move<node_index> root_{invalid_node};
+
+	/**
+	 * @brief Top-right corner of the live allocations; only rescanned after the allocation defining it is released.
+	 */
+	mutable exchange_on_move<point_type> used_bounds_{};
+	mutable exchange_on_move<bool> used_bounds_stale_{};
+
+	exchange_on_move<bool> track_dirty_{};
+
+	/**
+	 * @brief Decaying histogram of request areas behind adapt_fragment_threshold, one bucket per bit width.
+	 */
+	std::array<std::uint32_t, 65> request_areas_{};
+	exchange_on_move<std::uint32_t> requests_since_retarget_{};
+	exchange_on_move<bool> adaptive_threshold_{};
+
+	/**
+	 * @brief First node slot not yet checked against a moved fragment threshold; invalid_node when none is pending.
+	 */
+	exchange_on_move<node_index> repartition_cursor_{invalid_node};
+
+	static constexpr std::uint32_t retarget_interval = 256;
+	static constexpr std::uint32_t histogram_window = 4096;
+	static constexpr std::size_t repartition_step = 32;
+	static constexpr large_size_type min_adaptive_threshold = 64;
+
+	struct split_point;
+
+	using node_storage_type = std::vector<
+		split_point,
+		typename std::allocator_traits<allocator_type>::template rebind_alloc<split_point>>;
+
+	/**
+	 * @brief Maps a point to the deepest node starting there.
+	 *
+	 * Only the deepest node at a point can be free or hold an allocation, so this single table serves both
+	 * the free index lookups and deallocation; owners shadowed by a body root are reached through parent links.
+	 */
+	using map_type = flat_point_map<point_type, node_index, allocator_type>;
+
+	struct free_entry{
+		size_type major{};
+		size_type minor{};
+		point_type point{};
+	};
+
+	struct free_entry_compare{
+		bool operator()(const free_entry& lhs, const free_entry& rhs) const noexcept{
+			if(lhs.major != rhs.major) return lhs.major < rhs.major;
+			if(lhs.minor != rhs.minor) return lhs.minor < rhs.minor;
+			if(lhs.point.y != rhs.point.y) return lhs.point.y < rhs.point.y;
+			return lhs.point.x < rhs.point.x;
+		}
+	};
+
+	using free_tree_type = std::multiset<
+		free_entry,
+		free_entry_compare,
+		typename std::allocator_traits<allocator_type>::template rebind_alloc<free_entry>
+	>;
+
+	struct detached_handle{
+	};
+
+	template <bool Detached, typename = void>
+	struct index_handle_of{
+		using type = typename free_tree_type::iterator;
+	};
+
+	template <typename Void>
+	struct index_handle_of<true, Void>{
+		using type = detached_handle;
+	};
+
+	using index_handle = typename index_handle_of<position_independent>::type;
+
+	struct region_index{
+		using spare_list = std::vector<
+			typename free_tree_type::node_type,
+			typename std::allocator_traits<allocator_type>::template rebind_alloc<typename free_tree_type::node_type>>;
+
+		free_tree_type xy{};
+		free_tree_type yx{};
+		/**
+		 * @brief Tree nodes extracted on erase and handed to the next insert, so churn does not reach the allocator.
+		 */
+		spare_list spare{};
+
+		region_index() = default;
+
+		explicit region_index(const allocator_type& allocator)
+			: xy(typename free_tree_type::allocator_type{allocator}),
+			  yx(typename free_tree_type::allocator_type{allocator}),
+			  spare(allocator){
+		}
+
+		// spare nodes are only storage, so copies start without them
+		region_index(const region_index& other)
+			: xy(other.xy), yx(other.yx), spare(other.spare.get_allocator()){
+		}
+
+		region_index(region_index&& other) = default;
+
+		region_index& operator=(const region_index& other){
+			xy = other.xy;
+			yx = other.yx;
+			return *this;
+		}
+
+		region_index& operator=(region_index&& other) = default;
+
+		index_handle insert(free_tree_type& tree, const free_entry& entry){
+			if(spare.empty()) return tree.insert(entry);
+			auto node = std::move(spare.back());
+			spare.pop_back();
+			node.value() = entry;
+			return tree.insert(std::move(node));
+		}
+
+		void erase(free_tree_type& tree, const index_handle handle){
+			spare.push_back(tree.extract(handle));
+		}
+
+		/**
+		 * @brief Keep tree nodes for @p count entries in each tree.
+		 */
+		void reserve(const std::size_t count){
+			spare.reserve(count * 2);
+			while(xy.size() + yx.size() + spare.size() < count * 2){
+				spare.push_back(xy.extract(xy.insert(free_entry{})));
+			}
+		}
+
+		[[nodiscard]] std::size_t memory_usage() const noexcept{
+			// three links plus the color word
+			constexpr std::size_t node_overhead = sizeof(void*) * 4;
+			return (xy.size() + yx.size() + spare.size()) * (sizeof(free_entry) + node_overhead)
+				+ spare.capacity() * sizeof(typename free_tree_type::node_type);
+		}
+	};
+
+	/**
+	 * @brief Stands in for region_index in position independent mode, where every free region is a fragment.
+	 */
+	struct detached_region_index{
+		detached_region_index() = default;
+
+		explicit detached_region_index(const allocator_type&) noexcept{
+		}
+
+		void reserve(std::size_t) noexcept{
+		}
+
+		[[nodiscard]] std::size_t memory_usage() const noexcept{
+			return 0;
+		}
+	};
+
+	template <typename V>
+	using array_type = std::vector<V, typename std::allocator_traits<allocator_type>::template rebind_alloc<V>>;
+
+	struct fragment_entry{
+		point_type point{};
+		node_index node{};
+
+		/**
+		 * @brief Heap order, matching the point tie-break of better_choice_.
+		 */
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool before(const fragment_entry& other) const noexcept{
+			return point.y < other.point.y || (point.y == other.point.y && point.x < other.point.x);
+		}
+	};
+
+	/**
+	 * @brief Free fragments of one area class.
+	 *
+	 * Fragments of equal extent share a group, whose points form a min-heap in better_choice_ order, so a
+	 * bucket only lists each distinct extent once. Widths and heights of the groups sit in separate arrays
+	 * for SIMD filtering; an emptied group keeps its slot with a zero extent, which never fits.
+	 */
+	struct fragment_bucket{
+		array_type<size_type> widths{};
+		array_type<size_type> heights{};
+		array_type<array_type<fragment_entry>> groups{};
+		array_type<std::uint32_t> vacant{};
+
+		/**
+		 * @brief Largest width and height in the bucket; recomputed lazily after the group defining it empties.
+		 */
+		extent_type max_extent{};
+		bool max_extent_stale{};
+
+		fragment_bucket() = default;
+
+		explicit fragment_bucket(const allocator_type& allocator)
+			: widths(allocator), heights(allocator), groups(allocator), vacant(allocator){
+		}
+
+		[[nodiscard]] std::size_t memory_usage() const noexcept{
+			std::size_t bytes = widths.capacity() * sizeof(size_type) * 2 + vacant.capacity() * sizeof(std::uint32_t)
+				+ groups.capacity() * sizeof(array_type<fragment_entry>);
+			for(const auto& group : groups) bytes += group.capacity() * sizeof(fragment_entry);
+			return bytes;
+		}
+	};
+
+	/**
+	 * @brief Free regions at or below the fragment threshold, bucketed by the bit width of their area.
+	 *
+	 * Areas only grow from one bucket to the next, so the best fit lies in the first bucket that holds
+	 * any fitting group, and that bucket is filtered with one vectorized pass over its widths and heights.
+	 */
+	struct fragment_index{
+		struct node_slot{
+			std::uint32_t group{};
+			std::uint32_t position{};
+		};
+
+		array_type<fragment_bucket> buckets{};
+		/**
+		 * @brief Group and heap position of every indexed node, indexed by node.
+		 */
+		array_type<node_slot> slots{};
+		exchange_on_move<std::size_t> count{};
+
+		fragment_index() = default;
+
+		explicit fragment_index(const allocator_type& allocator)
+			: buckets(allocator), slots(allocator){
+		}
+
+		[[nodiscard]] static std::size_t bucket_of(const extent_type extent) noexcept{
+			return static_cast<std::size_t>(std::bit_width(area_of(extent)));
+		}
+
+		void insert(const node_index node, const point_type point, const extent_type extent){
+			const auto index = bucket_of(extent);
+			while(buckets.size() <= index) buckets.emplace_back(allocator_type{buckets.get_allocator()});
+			if(slots.size() <= node) slots.resize(std::max<std::size_t>(node + 1, slots.size() * 2));
+
+			auto& bucket = buckets[index];
+			auto group = find_group_(bucket, extent);
+			if(group == bucket.widths.size()){
+				if(bucket.vacant.empty()){
+					bucket.widths.push_back(extent.x);
+					bucket.heights.push_back(extent.y);
+					bucket.groups.emplace_back(allocator_type{buckets.get_allocator()});
+					// erase files emptied groups as vacant and must not allocate
+					bucket.vacant.reserve(bucket.widths.capacity());
+				} else{
+					group = bucket.vacant.back();
+					bucket.vacant.pop_back();
+					bucket.widths[group] = extent.x;
+					bucket.heights[group] = extent.y;
+				}
+				bucket.max_extent.x = std::max(bucket.max_extent.x, extent.x);
+				bucket.max_extent.y = std::max(bucket.max_extent.y, extent.y);
+			}
+
+			auto& heap = bucket.groups[group];
+			heap.push_back({point, node});
+			slots[node].group = static_cast<std::uint32_t>(group);
+			sift_up_(heap, heap.size() - 1);
+			++count.value;
+		}
+
+		/**
+		 * @brief Size the per-node slots for @p nodes nodes and create every bucket.
+		 */
+		void reserve(const std::size_t nodes){
+			// bit_width of a 64-bit area is at most 64
+			while(buckets.size() <= std::numeric_limits<large_size_type>::digits) buckets.emplace_back(allocator_type{buckets.get_allocator()});
+			if(slots.size() < nodes) slots.resize(nodes);
+		}
+
+		void erase(const node_index node, const extent_type extent) noexcept{
+			auto& bucket = buckets[bucket_of(extent)];
+			const auto [group, position] = slots[node];
+			auto& heap = bucket.groups[group];
+			assert(position < heap.size() && heap[position].node == node);
+
+			const auto last = heap.size() - 1;
+			if(position != last){
+				heap[position] = heap[last];
+				heap.pop_back();
+				sift_down_(heap, position);
+				sift_up_(heap, position);
+			} else{
+				heap.pop_back();
+			}
+
+			if(heap.empty()){
+				bucket.widths[group] = 0;
+				bucket.heights[group] = 0;
+				bucket.vacant.push_back(group);
+				if(extent.x == bucket.max_extent.x || extent.y == bucket.max_extent.y) bucket.max_extent_stale = true;
+			}
+			--count.value;
+		}
+
+		[[nodiscard]] extent_type max_extent() noexcept{
+			extent_type result{};
+			for(auto& bucket : buckets){
+				if(bucket.max_extent_stale){
+					bucket.max_extent = {};
+					for(std::size_t i = 0; i < bucket.widths.size(); ++i){
+						bucket.max_extent.x = std::max(bucket.max_extent.x, bucket.widths[i]);
+						bucket.max_extent.y = std::max(bucket.max_extent.y, bucket.heights[i]);
+					}
+					bucket.max_extent_stale = false;
+				}
+				result.x = std::max(result.x, bucket.max_extent.x);
+				result.y = std::max(result.y, bucket.max_extent.y);
+			}
+			return result;
+		}
+
+		[[nodiscard]] std::size_t memory_usage() const noexcept{
+			std::size_t bytes = buckets.capacity() * sizeof(fragment_bucket) + slots.capacity() * sizeof(node_slot);
+			for(const auto& bucket : buckets) bytes += bucket.memory_usage();
+			return bytes;
+		}
+
+	private:
+		[[nodiscard]] static std::size_t find_group_(const fragment_bucket& bucket, const extent_type extent) noexcept{
+			const auto count = bucket.widths.size();
+			std::size_t i = 0;
+			for(; i + fit_lanes <= count; i += fit_lanes){
+				if(const auto hits = match_mask_(bucket.widths.data() + i, bucket.heights.data() + i, extent)){
+					return i + std::countr_zero(hits);
+				}
+			}
+			for(; i < count; ++i){
+				if(bucket.widths[i] == extent.x && bucket.heights[i] == extent.y) return i;
+			}
+			return count;
+		}
+
+		void place_(array_type<fragment_entry>& heap, const std::size_t position, const fragment_entry entry) noexcept{
+			heap[position] = entry;
+			slots[entry.node].position = static_cast<std::uint32_t>(position);
+		}
+
+		void sift_up_(array_type<fragment_entry>& heap, std::size_t position) noexcept{
+			const auto entry = heap[position];
+			while(position > 0){
+				const auto parent = (position - 1) / 2;
+				if(!entry.before(heap[parent])) break;
+				place_(heap, position, heap[parent]);
+				position = parent;
+			}
+			place_(heap, position, entry);
+		}
+
+		void sift_down_(array_type<fragment_entry>& heap, std::size_t position) noexcept{
+			const auto entry = heap[position];
+			const auto size = heap.size();
+			for(auto child = position * 2 + 1; child < size; child = position * 2 + 1){
+				if(child + 1 < size && heap[child + 1].before(heap[child])) ++child;
+				if(!heap[child].before(entry)) break;
+				place_(heap, position, heap[child]);
+				position = child;
+			}
+			place_(heap, position, entry);
+		}
+	};
+
+	struct split_point{
+		point_type bot_lft{};
+		point_type top_rit{};
+		point_type split{top_rit};
+
+		/**
+		 * @brief Parent node (the owner for a body root); links the free slot chain once released.
+		 */
+		node_index parent{invalid_node};
+
+		bool idle : 1 {true};
+		bool idle_top : 1 {true};
+		bool idle_right : 1 {true};
+		bool in_free_tree : 1 {false};
+		bool in_fragment_tree : 1 {false};
+		bool wide_top_split : 1 {false};
+		bool is_top_child : 1 {false};
+		/**
+		 * @brief Covers the reused body of its parent, starting at the same point.
+		 */
+		bool is_body_root : 1 {false};
+		bool has_body_root : 1 {false};
+		/**
+		 * @brief The allocation holds a caller extent with swapped axes, see allocate_rotatable.
+		 */
+		bool rotated : 1 {false};
+
+		index_handle free_xy{};
+		index_handle free_yx{};
+
+		[[nodiscard]] split_point() = default;
+
+		[[nodiscard]] split_point(
+			const node_index parent,
+			const point_type bot_lft,
+			const point_type top_rit)
+			: bot_lft(bot_lft), top_rit(top_rit), parent(parent){
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool is_leaf() const noexcept{
+			return split == top_rit;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool is_split_idle() const noexcept{
+			return idle_top && idle_right;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] extent_type body_extent() const noexcept{
+			return split - bot_lft;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void clear_free_tree_state() noexcept{
+			in_free_tree = false;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool prefer_wide_top_split(const extent_type extent) const noexcept{
+			const auto remain_x = top_rit.x - (bot_lft.x + extent.x);
+			const auto remain_y = top_rit.y - (bot_lft.y + extent.y);
+			return remain_x < remain_y;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type top_region_src() const noexcept{
+			return {bot_lft.x, split.y};
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type top_region_end() const noexcept{
+			if(wide_top_split) return top_rit;
+			return {split.x, top_rit.y};
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type right_region_src() const noexcept{
+			return {split.x, bot_lft.y};
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] point_type right_region_end() const noexcept{
+			if(wide_top_split) return {top_rit.x, split.y};
+			return top_rit;
+		}
+
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void mark_captured(allocator2d& alloc) noexcept{
+			idle = false;
+
+			split_point* cur = this;
+			while(auto* parent = alloc.parent_node_of_(*cur)){
+				if(cur->is_body_root){
+					parent->idle = false;
+				} else if(cur->is_top_child){
+					parent->idle_top = false;
+				} else{
+					parent->idle_right = false;
+				}
+				cur = parent;
+			}
+		}
+
+		/**
+		 * @brief Reuse the idle body of a non-leaf node by covering it with a body root.
+		 */
+		MO_YANXI_ALLOCATOR_2D_FORCE_INLINE split_point& acquire_body(allocator2d& alloc){
+			assert(idle);
+			assert(!is_leaf());
+			alloc.erase_mark_(*this);
+			idle = false;
+			has_body_root = true;
+			auto& body_root = alloc.add_node_(alloc.index_of_(*this), bot_lft, split);
+			body_root.is_body_root = true;
+			return body_root;
+		}
+
+		bool check_merge(allocator2d& alloc) noexcept{
+			if(!idle || !is_split_idle()) return false;
+
+			const point_type top_src = top_region_src();
+			const point_type top_end = top_region_end();
+			if(area_of(top_end - top_src) > 0) alloc.erase_split_(top_src);
+
+			const point_type right_src = right_region_src();
+			const point_type right_end = right_region_end();
+			if(area_of(right_end - right_src) > 0) alloc.erase_split_(right_src);
+
+			alloc.erase_mark_(*this);
+			split = top_rit;
+			idle_top = true;
+			idle_right = true;
+			return true;
+		}
+
+		void acquire_and_split(allocator2d& alloc, const extent_type extent){
+			assert(idle);
+			assert(is_leaf());
+
+			// the fragment index finds the entry through the free extent, so unmark before splitting
+			alloc.erase_mark_(*this);
+
+			split = bot_lft + extent;
+			wide_top_split = prefer_wide_top_split(extent);
+
+			const node_index self = alloc.index_of_(*this);
+
+			const point_type right_src = right_region_src();
+			const point_type right_end = right_region_end();
+			if(area_of(right_end - right_src) > 0){
+				alloc.add_split_(self, right_src, right_end);
+			}
+
+			const point_type top_src = top_region_src();
+			const point_type top_end = top_region_end();
+			if(area_of(top_end - top_src) > 0){
+				alloc.add_split_(self, top_src, top_end);
+			}
+
+			mark_captured(alloc);
+			clear_free_tree_state();
+		}
+
+		/**
+		 * @brief Release the body of this node and merge upwards as far as possible.
+		 *
+		 * A body root that becomes a fully idle leaf is removed and hands its region back to its owner,
+		 * so the walk continues through reused bodies without any recursion.
+		 *
+		 * @return extent of the free region left after merging.
+		 */
+		extent_type mark_idle(allocator2d& alloc) noexcept{
+			assert(!idle);
+			idle = true;
+			rotated = false;
+			split_point* p = this;
+			split_point* last = this;
+			while(p->check_merge(alloc)){
+				last = p;
+				auto* next = alloc.parent_node_of_(*p);
+				if(next == nullptr) break;
+
+				if(p->is_body_root){
+					next->idle = true;
+					next->has_body_root = false;
+					alloc.erase_body_root_(*p);
+					last = next;
+				} else if(p->is_top_child){
+					next->idle_top = true;
+				} else{
+					next->idle_right = true;
+				}
+				p = next;
+			}
+
+			alloc.mark_size_(*last);
+			return last->split - last->bot_lft;
+		}
+	};
+
+	struct node_choice{
+		std::optional<point_type> point{};
+		extent_type extent{};
+		large_size_type area{std::numeric_limits<large_size_type>::max()};
+		size_type max_slack{std::numeric_limits<size_type>::max()};
+		size_type min_slack{std::numeric_limits<size_type>::max()};
+	};
+
+	node_storage_type nodes_{};
+	map_type map_{};
+	std::conditional_t<position_independent, detached_region_index, region_index> large_nodes_{};
+	mutable fragment_index frag_nodes_{};
+	region_list_type dirty_{};
+
+	/**
+	 * @brief Parked allocate_async requests in one FIFO list per bit width of their longer side.
+	 *
+	 * A release freeing a region of extent e can only satisfy requests up to the list of e, and the
+	 * requests are linked through their awaiters, so parking never allocates.
+	 */
+	struct waiter_index{
+		struct waiter_list{
+			allocation_awaiter* head{};
+			allocation_awaiter* tail{};
+		};
+
+		std::array<waiter_list, std::numeric_limits<size_type>::digits + 1> lists{};
+		std::size_t count{};
+
+		waiter_index() = default;
+
+		// parked requests stay with the allocator they were made on
+		waiter_index(const waiter_index&) noexcept{
+		}
+
+		waiter_index& operator=(const waiter_index&) noexcept{
+			return *this;
+		}
+
+		waiter_index(waiter_index&& other) noexcept{
+			splice(other);
+		}
+
+		waiter_index& operator=(waiter_index&& other) noexcept{
+			if(this != &other) splice(other);
+			return *this;
+		}
+
+		~waiter_index(){
+			// the coroutines stay suspended, see allocate_async
+			for(auto& list : lists){
+				for(auto* waiter = list.head; waiter; waiter = waiter->next_) waiter->index_ = nullptr;
+			}
+		}
+
+		[[nodiscard]] static std::size_t list_of(const extent_type extent) noexcept{
+			return static_cast<std::size_t>(std::bit_width(std::max(extent.x, extent.y)));
+		}
+
+		void push(allocation_awaiter& waiter) noexcept{
+			auto& list = lists[list_of(waiter.extent_)];
+			waiter.index_ = this;
+			waiter.prev_ = list.tail;
+			waiter.next_ = nullptr;
+			(list.tail ? list.tail->next_ : list.head) = &waiter;
+			list.tail = &waiter;
+			++count;
+		}
+
+		void erase(allocation_awaiter& waiter) noexcept{
+			auto& list = lists[list_of(waiter.extent_)];
+			(waiter.prev_ ? waiter.prev_->next_ : list.head) = waiter.next_;
+			(waiter.next_ ? waiter.next_->prev_ : list.tail) = waiter.prev_;
+			waiter.index_ = nullptr;
+			waiter.prev_ = nullptr;
+			waiter.next_ = nullptr;
+			--count;
+		}
+
+		/**
+		 * @brief Append the requests of @p other behind the ones already parked here.
+		 */
+		void splice(waiter_index& other) noexcept{
+			for(std::size_t i = 0; i < lists.size(); ++i){
+				auto& from = other.lists[i];
+				if(!from.head) continue;
+				for(auto* waiter = from.head; waiter; waiter = waiter->next_) waiter->index_ = this;
+				auto& to = lists[i];
+				if(to.tail){
+					to.tail->next_ = from.head;
+					from.head->prev_ = to.tail;
+				} else{
+					to.head = from.head;
+				}
+				to.tail = from.tail;
+				from = {};
+			}
+			count += std::exchange(other.count, 0);
+		}
+	};
+
+	waiter_index waiters_{};
+
+	/**
+	 * @brief Free extents of a subtree as a staircase of at most four steps, widest first.
+	 *
+	 * Every free region of the subtree fits inside some step. A longer staircase has its neighbouring steps
+	 * merged into their bounding extent, so it may promise a fit the subtree cannot give, never the reverse;
+	 * the widest and the tallest step always stay exact.
+	 */
+	struct free_staircase{
+		static constexpr std::size_t capacity = 4;
+		std::array<extent_type, capacity> steps{};
+
+		constexpr bool operator==(const free_staircase& other) const noexcept = default;
+
+		[[nodiscard]] bool fits(const extent_type size) const noexcept{
+			for(const auto step : steps){
+				if(step.x == 0) return false;
+				if(!size.beyond(step)) return true;
+			}
+			return false;
+		}
+
+		[[nodiscard]] extent_type bounds() const noexcept{
+			extent_type result{steps.front().x, 0};
+			for(const auto step : steps){
+				if(step.x == 0) break;
+				result.y = step.y;
+			}
+			return result;
+		}
+
+		/**
+		 * @brief Staircase over @p count extents in @p extents, which are reordered in place.
+		 */
+		[[nodiscard]] static free_staircase of(extent_type* extents, std::size_t count) noexcept{
+			std::sort(extents, extents + count, [](const extent_type lhs, const extent_type rhs){
+				return lhs.x != rhs.x ? lhs.x > rhs.x : lhs.y > rhs.y;
+			});
+
+			// drop every extent that fits inside a wider one
+			std::size_t size = 0;
+			for(std::size_t i = 0; i < count; ++i){
+				if(extents[i].x == 0 || extents[i].y == 0) continue;
+				if(size > 0 && extents[i].y <= extents[size - 1].y) continue;
+				extents[size++] = extents[i];
+			}
+
+			while(size > capacity){
+				// merge the neighbours whose bounding extent adds the least area
+				std::size_t best = 0;
+				large_size_type best_cost = std::numeric_limits<large_size_type>::max();
+				for(std::size_t i = 0; i + 1 < size; ++i){
+					const extent_type merged{extents[i].x, extents[i + 1].y};
+					const auto cost = area_of(merged)
+						- std::max(area_of(extents[i]), area_of(extents[i + 1]));
+					if(cost < best_cost){
+						best = i;
+						best_cost = cost;
+					}
+				}
+				extents[best].y = extents[best + 1].y;
+				std::copy(extents + best + 2, extents + size, extents + best + 1);
+				--size;
+			}
+
+			free_staircase result{};
+			std::copy(extents, extents + size, result.steps.begin());
+			return result;
+		}
+	};
+
+	struct subtree_entry{
+		free_staircase free{};
+		/**
+		 * @brief Body, right and top child, so the search does not go through the point map.
+		 */
+		std::array<node_index, 3> children{invalid_node, invalid_node, invalid_node};
+		bool queued{};
+	};
+
+	/**
+	 * @brief Per-node summaries behind use_subtree_search, indexed by node; empty while it is off.
+	 *
+	 * Changed nodes are queued and folded into their ancestors before the next read, so a burst of splits
+	 * and merges walks each ancestor chain only as far as the summaries actually change.
+	 */
+	mutable array_type<subtree_entry> subtree_free_{};
+	mutable array_type<node_index> subtree_queue_{};
+	exchange_on_move<bool> subtree_search_{};
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static bool better_choice_(const node_choice& lhs, const node_choice& rhs) noexcept{
+		if(!lhs.point) return false;
+		if(!rhs.point) return true;
+		if(lhs.area != rhs.area) return lhs.area < rhs.area;
+		if(lhs.max_slack != rhs.max_slack) return lhs.max_slack < rhs.max_slack;
+		if(lhs.min_slack != rhs.min_slack) return lhs.min_slack < rhs.min_slack;
+		return lhs.point.value() == rhs.point.value()
+			       ? false
+			       : lhs.point.value().y < rhs.point.value().y ||
+			       (lhs.point.value().y == rhs.point.value().y && lhs.point.value().x < rhs.point.value().x);
+	}
+
+	template <bool outer_is_x>
+	node_choice find_best_node_in_tree_(free_tree_type& tree, const extent_type size){
+		node_choice best{};
+		const auto outer_need = outer_is_x ? size.x : size.y;
 		const auto inner_need = outer_is_x ? size.y : size.x;
 		const auto max_size = std::numeric_limits<size_type>::max();
 
-		auto make_probe = [](const size_type major, const size_type minor, const point_type point) noexcept{
-			return free_entry{major, minor, point};
-		};
+		auto make_probe = [](const size_type major, const size_type minor, const point_type point) noexcept{
+			return free_entry{major, minor, point};
+		};
+
+		for(auto outer = tree.lower_bound(make_probe(outer_need, inner_need, {0, 0})); outer != tree.end();){
+			const auto outer_size = outer->major;
+			const auto optimistic_area = static_cast<large_size_type>(outer_size) * inner_need;
+			if(best.point && optimistic_area > best.area) break;
+
+			if(outer->minor < inner_need){
+				outer = tree.lower_bound(make_probe(outer_size, inner_need, {0, 0}));
+				continue;
+			}
+
+			const extent_type candidate_extent = outer_is_x
+				? extent_type{outer_size, outer->minor}
+				: extent_type{outer->minor, outer_size};
+			const extent_type slack = candidate_extent - size;
+
+			node_choice candidate{
+				.point = outer->point,
+				.extent = candidate_extent,
+				.area = area_of(candidate_extent),
+				.max_slack = std::max(slack.x, slack.y),
+				.min_slack = std::min(slack.x, slack.y),
+			};
+
+			if(better_choice_(candidate, best)){
+				best = candidate;
+			}
+
+			outer = tree.upper_bound(make_probe(outer_size, max_size, {max_size, max_size}));
+		}
+
+		return best;
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool is_fragment_(const point_type& size) const noexcept{
+		if constexpr(position_independent) return true;
+		return area_of(size) <= fragment_threshold_.value;
+	}
+
+	[[nodiscard]] std::size_t large_index_size_() const noexcept{
+		if constexpr(position_independent) return 0;
+		else return large_nodes_.xy.size();
+	}
+
+	node_choice find_best_node_(region_index& tree, const extent_type size){
+		if(size.x >= size.y){
+			return find_best_node_in_tree_<true>(tree.xy, size);
+		}
+		return find_best_node_in_tree_<false>(tree.yx, size);
+	}
+
+#if MO_YANXI_ALLOCATOR_2D_HAS_AVX2
+	static constexpr std::size_t fit_lanes = 32 / sizeof(size_type);
+#elif MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+	static constexpr std::size_t fit_lanes = 16 / sizeof(size_type);
+#else
+	static constexpr std::size_t fit_lanes = 1;
+#endif
+
+#if MO_YANXI_ALLOCATOR_2D_HAS_AVX2
+	/**
+	 * @brief One bit per 16-bit lane of @p lanes, which hold all ones or all zeros.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static std::uint32_t lane_mask16_(const __m256i lanes) noexcept{
+		// packing works per 128-bit half, leaving the lanes of the upper half in bytes 16 to 23
+		const auto bytes = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_packs_epi16(lanes, _mm256_setzero_si256())));
+		return (bytes & 0xffu) | (bytes >> 8 & 0xff00u);
+	}
+#elif MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+	/**
+	 * @brief One bit per 16-bit lane of @p lanes, which hold all ones or all zeros.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static std::uint32_t lane_mask16_(const __m128i lanes) noexcept{
+		return static_cast<std::uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(lanes, _mm_setzero_si128())));
+	}
+#endif
+
+	/**
+	 * @brief Bitmask of the fit_lanes entries from @p widths and @p heights that hold @p size.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static std::uint32_t fit_mask_(
+		const size_type* widths, const size_type* heights, const extent_type size) noexcept{
+#if MO_YANXI_ALLOCATOR_2D_HAS_AVX2
+		const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(widths));
+		const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heights));
+		// w >= need exactly when max(w, need) == w
+		if constexpr(sizeof(size_type) == sizeof(std::uint16_t)){
+			const __m256i need_w = _mm256_set1_epi16(static_cast<short>(size.x));
+			const __m256i need_h = _mm256_set1_epi16(static_cast<short>(size.y));
+			return lane_mask16_(_mm256_and_si256(
+				_mm256_cmpeq_epi16(_mm256_max_epu16(w, need_w), w),
+				_mm256_cmpeq_epi16(_mm256_max_epu16(h, need_h), h)));
+		} else{
+			const __m256i need_w = _mm256_set1_epi32(static_cast<int>(size.x));
+			const __m256i need_h = _mm256_set1_epi32(static_cast<int>(size.y));
+			const __m256i fits = _mm256_and_si256(
+				_mm256_cmpeq_epi32(_mm256_max_epu32(w, need_w), w),
+				_mm256_cmpeq_epi32(_mm256_max_epu32(h, need_h), h));
+			return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(fits)));
+		}
+#elif MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+		// SSE2 only compares signed lanes, so flip the sign bits first
+		if constexpr(sizeof(size_type) == sizeof(std::uint16_t)){
+			const __m128i bias = _mm_set1_epi16(std::numeric_limits<std::int16_t>::min());
+			const __m128i w = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(widths)), bias);
+			const __m128i h = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(heights)), bias);
+			const __m128i need_w = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(size.x)), bias);
+			const __m128i need_h = _mm_xor_si128(_mm_set1_epi16(static_cast<short>(size.y)), bias);
+			const __m128i misses = _mm_or_si128(_mm_cmpgt_epi16(need_w, w), _mm_cmpgt_epi16(need_h, h));
+			return ~lane_mask16_(misses) & 0xffu;
+		} else{
+			const __m128i bias = _mm_set1_epi32(std::numeric_limits<std::int32_t>::min());
+			const __m128i w = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(widths)), bias);
+			const __m128i h = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(heights)), bias);
+			const __m128i need_w = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(size.x)), bias);
+			const __m128i need_h = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(size.y)), bias);
+			const __m128i misses = _mm_or_si128(_mm_cmpgt_epi32(need_w, w), _mm_cmpgt_epi32(need_h, h));
+			return ~static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(misses))) & 0xfu;
+		}
+#else
+		return widths[0] >= size.x && heights[0] >= size.y;
+#endif
+	}
+
+	/**
+	 * @brief Bitmask of the fit_lanes entries from @p widths and @p heights equal to @p extent.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE static std::uint32_t match_mask_(
+		const size_type* widths, const size_type* heights, const extent_type extent) noexcept{
+#if MO_YANXI_ALLOCATOR_2D_HAS_AVX2
+		const __m256i w = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(widths));
+		const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(heights));
+		if constexpr(sizeof(size_type) == sizeof(std::uint16_t)){
+			return lane_mask16_(_mm256_and_si256(
+				_mm256_cmpeq_epi16(w, _mm256_set1_epi16(static_cast<short>(extent.x))),
+				_mm256_cmpeq_epi16(h, _mm256_set1_epi16(static_cast<short>(extent.y)))));
+		} else{
+			const __m256i equal = _mm256_and_si256(
+				_mm256_cmpeq_epi32(w, _mm256_set1_epi32(static_cast<int>(extent.x))),
+				_mm256_cmpeq_epi32(h, _mm256_set1_epi32(static_cast<int>(extent.y))));
+			return static_cast<std::uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(equal)));
+		}
+#elif MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+		const __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(widths));
+		const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(heights));
+		if constexpr(sizeof(size_type) == sizeof(std::uint16_t)){
+			return lane_mask16_(_mm_and_si128(
+				_mm_cmpeq_epi16(w, _mm_set1_epi16(static_cast<short>(extent.x))),
+				_mm_cmpeq_epi16(h, _mm_set1_epi16(static_cast<short>(extent.y)))));
+		} else{
+			const __m128i equal = _mm_and_si128(
+				_mm_cmpeq_epi32(w, _mm_set1_epi32(static_cast<int>(extent.x))),
+				_mm_cmpeq_epi32(h, _mm_set1_epi32(static_cast<int>(extent.y))));
+			return static_cast<std::uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(equal)));
+		}
+#else
+		return widths[0] == extent.x && heights[0] == extent.y;
+#endif
+	}
+
+	static node_choice find_best_in_bucket_(const fragment_bucket& bucket, const extent_type size) noexcept{
+		node_choice best{};
+		const auto consider = [&](const std::size_t i){
+			const extent_type candidate_extent{bucket.widths[i], bucket.heights[i]};
+			const extent_type slack = candidate_extent - size;
+			const node_choice candidate{
+				.point = bucket.groups[i].front().point,
+				.extent = candidate_extent,
+				.area = area_of(candidate_extent),
+				.max_slack = std::max(slack.x, slack.y),
+				.min_slack = std::min(slack.x, slack.y),
+			};
+			if(better_choice_(candidate, best)) best = candidate;
+		};
+
+		const auto count = bucket.widths.size();
+		std::size_t i = 0;
+		for(; i + fit_lanes <= count; i += fit_lanes){
+			for(auto hits = fit_mask_(bucket.widths.data() + i, bucket.heights.data() + i, size); hits; hits &= hits - 1){
+				consider(i + std::countr_zero(hits));
+			}
+		}
+		for(; i < count; ++i){
+			if(bucket.widths[i] >= size.x && bucket.heights[i] >= size.y) consider(i);
+		}
+		return best;
+	}
+
+	node_choice find_best_node_(const fragment_index& index, const extent_type size) const noexcept{
+		for(auto bucket = fragment_index::bucket_of(size); bucket < index.buckets.size(); ++bucket){
+			const auto& entries = index.buckets[bucket];
+			// the bound only ever overestimates, so it can skip a bucket but never hide a fit
+			if(size.beyond(entries.max_extent)) continue;
+			if(auto best = find_best_in_bucket_(entries, size); best.point) return best;
+		}
+		return {};
+	}
+
+	node_choice find_best_direct_node_(const extent_type size){
+		auto frag_node = find_best_node_(frag_nodes_, size);
+		if constexpr(!position_independent){
+			if(!frag_node.point) return find_best_node_(large_nodes_, size);
+		}
+		return frag_node;
+	}
+
+	/**
+	 * @brief Best node for @p size in either orientation; the rotated one only wins when it is strictly better.
+	 */
+	template <typename Index>
+	node_choice find_best_rotatable_node_(Index& tree, const extent_type size, const bool try_upright, const bool try_rotated, bool& rotated){
+		node_choice upright{};
+		if(try_upright) upright = find_best_node_(tree, size);
+		if(!try_rotated) return upright;
+
+		auto swapped = find_best_node_(tree, {size.y, size.x});
+		rotated = better_choice_(swapped, upright);
+		return rotated ? swapped : upright;
+	}
+
+	/**
+	 * @brief Point of @p size in the free region at @p src with extent @p free, rounded up to @p alignment,
+	 * if it still fits there.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] static std::optional<point_type> aligned_point_(
+		const point_type src, const extent_type free, const extent_type size, const size_type alignment) noexcept{
+		const auto pad_x = static_cast<size_type>((alignment - src.x % alignment) % alignment);
+		const auto pad_y = static_cast<size_type>((alignment - src.y % alignment) % alignment);
+		if(pad_x > free.x || pad_y > free.y || size.x > free.x - pad_x || size.y > free.y - pad_y) return std::nullopt;
+		return point_type{static_cast<size_type>(src.x + pad_x), static_cast<size_type>(src.y + pad_y)};
+	}
+
+	[[nodiscard]] static node_choice aligned_choice_(const point_type point, const extent_type free, const extent_type size) noexcept{
+		const extent_type slack = free - size;
+		return {
+			.point = point,
+			.extent = free,
+			.area = area_of(free),
+			.max_slack = std::max(slack.x, slack.y),
+			.min_slack = std::min(slack.x, slack.y),
+		};
+	}
+
+	/**
+	 * @brief find_best_node_in_tree_ for a point aligned to @p alignment.
+	 *
+	 * Entries of one outer size come by inner size, so the first aligned fit ends the walk of its column.
+	 */
+	template <bool outer_is_x>
+	[[nodiscard]] node_choice find_aligned_in_tree_(const free_tree_type& tree, const extent_type size, const size_type alignment) const noexcept{
+		node_choice best{};
+		const auto outer_need = outer_is_x ? size.x : size.y;
+		const auto inner_need = outer_is_x ? size.y : size.x;
+		constexpr auto max_size = std::numeric_limits<size_type>::max();
+
+		for(auto outer = tree.lower_bound(free_entry{outer_need, inner_need, {}}); outer != tree.end();){
+			const auto outer_size = outer->major;
+			if(best.point && static_cast<large_size_type>(outer_size) * inner_need > best.area) break;
+
+			if(outer->minor < inner_need){
+				outer = tree.lower_bound(free_entry{outer_size, inner_need, {}});
+				continue;
+			}
+
+			for(auto entry = outer; entry != tree.end() && entry->major == outer_size; ++entry){
+				const extent_type free = outer_is_x ? extent_type{outer_size, entry->minor} : extent_type{entry->minor, outer_size};
+				if(best.point && area_of(free) > best.area) break;
+				if(const auto point = aligned_point_(entry->point, free, size, alignment)){
+					if(const auto candidate = aligned_choice_(*point, free, size); better_choice_(candidate, best)) best = candidate;
+					break;
+				}
+			}
+
+			outer = tree.upper_bound(free_entry{outer_size, max_size, {max_size, max_size}});
+		}
+
+		return best;
+	}
+
+	/**
+	 * @brief find_best_in_bucket_ for a point aligned to @p alignment.
+	 *
+	 * Every point of a group is tried unless the group extent leaves room for any padding, when its first
+	 * point fits.
+	 */
+	static node_choice find_aligned_in_bucket_(const fragment_bucket& bucket, const extent_type size, const size_type alignment) noexcept{
+		node_choice best{};
+		const auto consider = [&](const std::size_t i){
+			const extent_type free{bucket.widths[i], bucket.heights[i]};
+			if(best.point && area_of(free) > best.area) return;
+
+			const auto& group = bucket.groups[i];
+			if(free.x - size.x >= alignment - 1 && free.y - size.y >= alignment - 1){
+				const auto point = aligned_point_(group.front().point, free, size, alignment);
+				if(const auto candidate = aligned_choice_(*point, free, size); better_choice_(candidate, best)) best = candidate;
+				return;
+			}
+			for(const auto& entry : group){
+				if(const auto point = aligned_point_(entry.point, free, size, alignment)){
+					if(const auto candidate = aligned_choice_(*point, free, size); better_choice_(candidate, best)) best = candidate;
+				}
+			}
+		};
+
+		const auto count = bucket.widths.size();
+		std::size_t i = 0;
+		for(; i + fit_lanes <= count; i += fit_lanes){
+			for(auto hits = fit_mask_(bucket.widths.data() + i, bucket.heights.data() + i, size); hits; hits &= hits - 1){
+				consider(i + std::countr_zero(hits));
+			}
+		}
+		for(; i < count; ++i){
+			if(bucket.widths[i] >= size.x && bucket.heights[i] >= size.y) consider(i);
+		}
+		return best;
+	}
+
+	node_choice find_aligned_node_(const fragment_index& index, const extent_type size, const size_type alignment) const noexcept{
+		for(auto bucket = fragment_index::bucket_of(size); bucket < index.buckets.size(); ++bucket){
+			const auto& entries = index.buckets[bucket];
+			if(size.beyond(entries.max_extent)) continue;
+			if(auto best = find_aligned_in_bucket_(entries, size, alignment); best.point) return best;
+		}
+		return {};
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] node_index index_of_(const split_point& node) const noexcept{
+		return static_cast<node_index>(&node - nodes_.data());
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] split_point* node_at_(const point_type point) noexcept{
+		const auto* slot = map_.find(point);
+		if(slot == nullptr) return nullptr;
+		return &nodes_[*slot];
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] const split_point* node_at_(const point_type point) const noexcept{
+		const auto* slot = map_.find(point);
+		if(slot == nullptr) return nullptr;
+		return &nodes_[*slot];
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] split_point* parent_node_of_(split_point& node) noexcept{
+		if(node.parent == invalid_node) return nullptr;
+		return &nodes_[node.parent];
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] const split_point* parent_node_of_(const split_point& node) const noexcept{
+		if(node.parent == invalid_node) return nullptr;
+		return &nodes_[node.parent];
+	}
+
+	/**
+	 * @brief Make room for @p count new nodes so that references held during a split stay valid.
+	 */
+	void reserve_node_slots_(const std::size_t count){
+		if(nodes_.capacity() - nodes_.size() >= count) return;
+		nodes_.reserve(std::max(nodes_.capacity() * 2, nodes_.size() + count));
+	}
+
+	[[nodiscard]] node_index acquire_node_slot_(){
+		if(free_node_.value != invalid_node){
+			const auto slot = free_node_.value;
+			free_node_ = nodes_[slot].parent;
+			if(subtree_search_.value) subtree_free_[slot] = {};
+			return slot;
+		}
+
+		assert(nodes_.size() < invalid_node);
+		nodes_.emplace_back();
+		if(subtree_search_.value && subtree_free_.size() < nodes_.size()){
+			subtree_free_.resize(std::max(nodes_.capacity(), subtree_free_.size() * 2));
+		}
+		return static_cast<node_index>(nodes_.size() - 1);
+	}
+
+	void release_node_slot_(const node_index slot) noexcept{
+		auto& node = nodes_[slot];
+		assert(!node.in_free_tree);
+		if(subtree_search_.value && node.parent != invalid_node){
+			subtree_free_[node.parent].children[child_position_(slot_of_(node))] = invalid_node;
+			queue_summary_(node.parent);
+		}
+		node.parent = free_node_.value;
+		node.idle = true;
+		node.has_body_root = false;
+		free_node_ = slot;
+	}
+
+	void mark_size_(split_point& node){
+		if(subtree_search_.value){
+			node.in_fragment_tree = false;
+			node.in_free_tree = true;
+			queue_summary_(index_of_(node));
+			return;
+		}
+
+		const auto src = node.bot_lft;
+		const auto size = node.split - src;
+
+		if(is_fragment_(size)){
+			frag_nodes_.insert(index_of_(node), src, size);
+			node.in_fragment_tree = true;
+		} else if constexpr(!position_independent){
+			node.free_xy = large_nodes_.insert(large_nodes_.xy, {size.x, size.y, src});
+			node.free_yx = large_nodes_.insert(large_nodes_.yx, {size.y, size.x, src});
+			node.in_fragment_tree = false;
+		}
+
+		node.in_free_tree = true;
+	}
+
+	split_point& add_node_(const node_index parent, const point_type src, const point_type dst){
+		const auto slot = acquire_node_slot_();
+		auto& node = nodes_[slot];
+		node = split_point{parent, src, dst};
+		map_.insert_or_assign(src, slot);
+
+		if(parent != invalid_node){
+			const auto parent_src = nodes_[parent].bot_lft;
+			node.is_top_child = parent_src != src && src.x == parent_src.x;
+			if(subtree_search_.value){
+				// only a body root starts at the point of its parent
+				const auto position = parent_src == src ? child_slot::body : node.is_top_child ? child_slot::top : child_slot::right;
+				subtree_free_[parent].children[child_position_(position)] = slot;
+			}
+		}
+		return node;
+	}
+
+	void add_split_(const node_index parent, const point_type src, const point_type dst){
+		mark_size_(add_node_(parent, src, dst));
+	}
+
+	void erase_split_(const point_type src){
+		const auto* found = map_.find(src);
+		assert(found != nullptr);
+		const auto slot = *found;
+		erase_mark_(nodes_[slot]);
+		map_.erase(src);
+		release_node_slot_(slot);
+	}
+
+	void erase_body_root_(split_point& node) noexcept{
+		assert(node.is_body_root);
+		assert(node.is_leaf() && !node.in_free_tree);
+		map_.insert_or_assign(node.bot_lft, node.parent);
+		release_node_slot_(index_of_(node));
+	}
+
+	void erase_mark_(split_point& node){
+		if(!node.in_free_tree) return;
+
+		if(subtree_search_.value){
+			queue_summary_(index_of_(node));
+		} else if(node.in_fragment_tree){
+			frag_nodes_.erase(index_of_(node), node.split - node.bot_lft);
+		} else if constexpr(!position_independent){
+			large_nodes_.erase(large_nodes_.xy, node.free_xy);
+			large_nodes_.erase(large_nodes_.yx, node.free_yx);
+		}
+
+		node.clear_free_tree_state();
+	}
 
-		for(auto outer = tree.lower_bound(make_probe(outer_need, inner_need, {0, 0})); outer != tree.end();){
-			const auto outer_size = outer->major;
-			const auto optimistic_area = static_cast<large_size_type>(outer_size) * inner_need;
-			if(best.point && optimistic_area > best.area) break;
+	/**
+	 * @brief Count @p extent in the request histogram and move the threshold every retarget_interval requests.
+	 */
+	void observe_request_(const extent_type extent) noexcept{
+		if(!adaptive_threshold_.value) return;
+		++request_areas_[std::bit_width(area_of(extent))];
+		if(++requests_since_retarget_.value < retarget_interval) return;
+		requests_since_retarget_ = 0;
+		retarget_threshold_();
+	}
 
-			if(outer->minor < inner_need){
-				outer = tree.lower_bound(make_probe(outer_size, inner_need, {0, 0}));
+	void retarget_threshold_() noexcept{
+		std::uint64_t total{};
+		for(const auto count : request_areas_) total += count;
+		if(total == 0) return;
+
+		std::size_t median{};
+		for(std::uint64_t seen{}; median < request_areas_.size(); ++median){
+			seen += request_areas_[median];
+			if(seen * 2 >= total) break;
+		}
+		if(total > histogram_window){
+			for(auto& count : request_areas_) count /= 2;
+		}
+
+		// bucket b holds areas in [2^(b-1), 2^b), so 2^(b+2) is 4 to 8 times the median request
+		const auto target = std::clamp<large_size_type>(
+			large_size_type{1} << std::min<std::size_t>(median + 2, 62),
+			min_adaptive_threshold, std::max(total_area_() / 16, min_adaptive_threshold));
+		if(target == fragment_threshold_.value) return;
+		fragment_threshold_ = target;
+		repartition_cursor_ = 0;
+	}
+
+	/**
+	 * @brief Move up to repartition_step free nodes to the index matching the current threshold.
+	 *
+	 * Both indexes are always searched before an allocation fails, so a partially repartitioned state
+	 * only affects which fitting region is found first.
+	 */
+	void repartition_step_(){
+		if(repartition_cursor_.value == invalid_node || subtree_search_.value) return;
+		const auto end = std::min<std::size_t>(nodes_.size(), repartition_cursor_.value + repartition_step);
+		for(std::size_t i = repartition_cursor_.value; i < end; ++i){
+			auto& node = nodes_[i];
+			if(!node.in_free_tree || node.in_fragment_tree == is_fragment_(node.body_extent())) continue;
+			erase_mark_(node);
+			mark_size_(node);
+		}
+		repartition_cursor_ = end == nodes_.size() ? invalid_node : static_cast<node_index>(end);
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool repartition_pending_(const std::size_t index) const noexcept{
+		return repartition_cursor_.value != invalid_node && index >= repartition_cursor_.value;
+	}
+
+	void init_threshold_(const extent_type extent){
+		if(!fragment_threshold_.value){
+			fragment_threshold_ = std::max<large_size_type>(area_of(extent) / 64, 96 * 96);
+		}
+	}
+
+	void init_root_(const extent_type extent){
+		init_threshold_(extent);
+		root_ = acquire_node_slot_();
+		nodes_[root_.value] = split_point{invalid_node, {}, extent};
+		map_.insert_or_assign({}, root_.value);
+		mark_size_(nodes_[root_.value]);
+	}
+
+	/**
+	 * @brief Put a new root over the current one, whose whole region becomes the body of the new root.
+	 *
+	 * The old root turns into the body root of the new one, so it merges back through the usual body
+	 * release path once everything inside it is free.
+	 */
+	void wrap_root_(const extent_type new_extent){
+		const auto old_extent = extent_.value;
+		reserve_node_slots_(3);
+
+		const auto wrapper = acquire_node_slot_();
+		auto& root = nodes_[wrapper];
+		root = split_point{invalid_node, {}, new_extent};
+		root.split = old_extent;
+		root.wide_top_split = root.prefer_wide_top_split(old_extent);
+		root.idle = false;
+		root.has_body_root = true;
+
+		auto& old_root = nodes_[root_.value];
+		old_root.parent = wrapper;
+		old_root.is_body_root = true;
+
+		const point_type right_src = root.right_region_src();
+		const point_type right_end = root.right_region_end();
+		if(area_of(right_end - right_src) > 0){
+			add_split_(wrapper, right_src, right_end);
+		}
+
+		const point_type top_src = root.top_region_src();
+		const point_type top_end = root.top_region_end();
+		if(area_of(top_end - top_src) > 0){
+			add_split_(wrapper, top_src, top_end);
+		}
+
+		if(subtree_search_.value) subtree_free_[wrapper].children[child_position_(child_slot::body)] = root_.value;
+		root_ = wrapper;
+		queue_summary_(wrapper);
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] large_size_type total_area_() const noexcept{
+		return area_of(extent_.value);
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool can_hold_(const extent_type extent) const noexcept{
+		if(area_of(extent) == 0) return false;
+		if(extent.beyond(extent_.value)) return false;
+		return remain_area_.value >= area_of(extent);
+	}
+
+	split_point* allocate_local_(const extent_type extent){
+		observe_request_(extent);
+		repartition_step_();
+		return place_best_(extent);
+	}
+
+	/**
+	 * @brief Search and place @p extent without counting it as a request, e.g. for a woken allocate_async.
+	 */
+	split_point* place_best_(const extent_type extent){
+		if(!can_hold_(extent)) return nullptr;
+
+		if(subtree_search_.value){
+			const auto found = find_first_fit_subtree_(extent);
+			if(found == invalid_node) return nullptr;
+			return place_(nodes_[found].bot_lft, extent);
+		}
+
+		const auto candidate = find_best_direct_node_(extent);
+		if(!candidate.point) return nullptr;
+		return place_(candidate.point.value(), extent);
+	}
+
+	/**
+	 * @brief Allocate @p extent in the free node found at @p point.
+	 */
+	split_point* place_(const point_type point, const extent_type extent){
+		// a body root plus its two children
+		reserve_node_slots_(3);
+		// and the dirty rect, so recording it cannot fail after the split
+		if(track_dirty_.value && dirty_.size() == dirty_.capacity()) dirty_.reserve(dirty_.size() * 2 + 1);
+
+		auto* node = node_at_(point);
+		assert(node != nullptr);
+		if(!node->is_leaf()){
+			node = &node->acquire_body(*this);
+		}
+		node->acquire_and_split(*this, extent);
+		note_allocated_(*node);
+		return node;
+	}
+
+	void note_allocated_(const split_point& node){
+		remain_area_.value -= area_of(node.body_extent());
+		used_bounds_.value.x = std::max(used_bounds_.value.x, node.split.x);
+		used_bounds_.value.y = std::max(used_bounds_.value.y, node.split.y);
+		if(track_dirty_.value) add_dirty_({node.bot_lft, node.body_extent()});
+	}
+
+	struct layout_cut{
+		bool horizontal{};
+		size_type at{};
+		std::size_t body_count{};
+	};
+
+	using layout_order = std::span<node_index>;
+
+	/**
+	 * @brief First guillotine cut of the box [@p src, @p end) along one axis that no rect crosses.
+	 *
+	 * @param order indices into @p rects sorted by their start on that axis.
+	 */
+	template <bool horizontal>
+	static std::optional<layout_cut> scan_layout_cut_(
+		const point_type src, const point_type end, const region* rects, const layout_order order) noexcept{
+		const auto start_of = [=](const node_index i){ return horizontal ? rects[i].src.y : rects[i].src.x; };
+		const auto end_of = [=](const node_index i){ return horizontal ? rects[i].end().y : rects[i].end().x; };
+		const size_type low = horizontal ? src.y : src.x;
+		const size_type high = horizontal ? end.y : end.x;
+
+		if(start_of(order.front()) > low){
+			if(start_of(order.front()) < high) return layout_cut{horizontal, start_of(order.front()), 0};
+			return std::nullopt;
+		}
+
+		size_type reach = end_of(order.front());
+		for(std::size_t i = 1; i < order.size(); ++i){
+			if(start_of(order[i]) >= reach) return layout_cut{horizontal, reach, i};
+			reach = std::max(reach, end_of(order[i]));
+		}
+		if(reach < high) return layout_cut{horizontal, reach, order.size()};
+		return std::nullopt;
+	}
+
+	/**
+	 * @brief Move the rects below @p cut to the front of @p order, keeping the relative order on both sides.
+	 */
+	static void partition_layout_order_(const region* rects, const layout_order order, const layout_order scratch, const layout_cut cut) noexcept{
+		std::size_t body{};
+		std::size_t rest{};
+		for(const auto i : order){
+			const auto rect_end = cut.horizontal ? rects[i].end().y : rects[i].end().x;
+			if(rect_end <= cut.at){
+				order[body++] = i;
+			} else{
+				scratch[rest++] = i;
+			}
+		}
+		std::ranges::copy(scratch.first(rest), order.begin() + body);
+	}
+
+	/**
+	 * @brief Mark rects as allocated inside the free leaf at @p index, covering [@p src, @p end), by guillotine cuts.
+	 *
+	 * The rects are given by two index orders over @p rects, sorted by x and by y start; both are kept in
+	 * step by stable partitions, so each cut costs linear time and nothing is sorted again. Each cut puts
+	 * the low side in the body of the current node and continues in the child on the high side. A body that
+	 * is exactly one rect becomes its allocation, otherwise it is covered by a body root and laid out
+	 * recursively.
+	 *
+	 * @tparam commit when false, only checks that the rects can be laid out; nothing is touched but the orders.
+	 * The leaf must not be in a free index when committing; every free region created on the way is indexed.
+	 * @return false if the rects leave the box, overlap, or cannot be separated by guillotine cuts.
+	 */
+	template <bool commit>
+	bool build_layout_(node_index index, point_type src, point_type end,
+		const region* rects, layout_order by_x, layout_order by_y, const layout_order scratch){
+		while(true){
+			if constexpr(commit){
+				// a body root plus two children
+				reserve_node_slots_(3);
+			}
+
+			if(by_x.empty()){
+				if constexpr(commit) mark_size_(nodes_[index]);
+				return true;
+			}
+
+			if(by_x.size() == 1 && rects[by_x.front()].src == src){
+				const auto& rect = rects[by_x.front()];
+				if(rect.end().beyond(end) || area_of(rect.extent) == 0) return false;
+				if constexpr(commit){
+					auto& node = nodes_[index];
+					node.acquire_and_split(*this, rect.extent);
+					note_allocated_(node);
+				}
+				return true;
+			}
+
+			auto cut = scan_layout_cut_<false>(src, end, rects, by_x);
+			if(!cut || cut->body_count > 0){
+				// prefer the cut leaving fewer rects in the body, which keeps the recursion shallow
+				if(const auto other = scan_layout_cut_<true>(src, end, rects, by_y); other && (!cut || other->body_count < cut->body_count)){
+					cut = other;
+				}
+			}
+			if(!cut) return false;
+
+			partition_layout_order_(rects, cut->horizontal ? by_x : by_y, scratch, *cut);
+			const auto body_x = by_x.first(cut->body_count);
+			const auto body_y = by_y.first(cut->body_count);
+
+			const region* single = cut->body_count == 1 ? &rects[body_x.front()] : nullptr;
+			const bool fills = single && single->src == src
+				&& (cut->horizontal ? single->end().y : single->end().x) == cut->at
+				&& !single->end().beyond(end);
+
+			split_point shape{invalid_node, src, end};
+			shape.wide_top_split = cut->horizontal;
+			if(fills){
+				shape.split = single->end();
+			} else{
+				shape.split = cut->horizontal ? point_type{end.x, cut->at} : point_type{cut->at, end.y};
+			}
+
+			const point_type rest_src = cut->horizontal ? shape.top_region_src() : shape.right_region_src();
+			const point_type rest_end = cut->horizontal ? shape.top_region_end() : shape.right_region_end();
+			const point_type spare_src = cut->horizontal ? shape.right_region_src() : shape.top_region_src();
+			const point_type spare_end = cut->horizontal ? shape.right_region_end() : shape.top_region_end();
+
+			const bool has_rest = area_of(rest_end - rest_src) > 0;
+			if(!has_rest && cut->body_count != by_x.size()) return false;
+
+			if constexpr(commit){
+				auto& node = nodes_[index];
+				node.split = shape.split;
+				node.wide_top_split = shape.wide_top_split;
+
+				if(area_of(spare_end - spare_src) > 0) add_split_(index, spare_src, spare_end);
+
+				const node_index rest_index = has_rest ? index_of_(add_node_(index, rest_src, rest_end)) : invalid_node;
+
+				if(fills){
+					node.mark_captured(*this);
+					note_allocated_(node);
+				} else if(cut->body_count == 0){
+					mark_size_(node);
+				} else{
+					node.has_body_root = true;
+					auto& body_root = add_node_(index, src, shape.split);
+					body_root.is_body_root = true;
+					if(!build_layout_<true>(index_of_(body_root), src, shape.split, rects, body_x, body_y, scratch)) return false;
+				}
+				index = rest_index;
+			} else if(!fills && cut->body_count > 0){
+				if(!build_layout_<false>(invalid_node, src, shape.split, rects, body_x, body_y, scratch)) return false;
+			}
+
+			if(!has_rest) return true;
+			src = rest_src;
+			end = rest_end;
+			by_x = by_x.subspan(cut->body_count);
+			by_y = by_y.subspan(cut->body_count);
+		}
+	}
+
+	/**
+	 * @brief Free node whose free region contains @p rect, or invalid_node if it overlaps an allocation
+	 * or crosses the border between two regions of the split tree.
+	 */
+	[[nodiscard]] node_index free_node_containing_(const region& rect) const noexcept{
+		node_index current = root_.value;
+		while(true){
+			const auto& node = nodes_[current];
+			if(region{node.bot_lft, node.body_extent()}.contains(rect)){
+				if(node.has_body_root){
+					current = child_at_(current, node.bot_lft);
+					continue;
+				}
+				return node.idle ? current : invalid_node;
+			}
+			if(node.is_leaf()) return invalid_node;
+
+			const region right{node.right_region_src(), node.right_region_end() - node.right_region_src()};
+			if(area_of(right.extent) > 0 && right.contains(rect)){
+				current = child_at_(current, right.src);
+				continue;
+			}
+			const region top{node.top_region_src(), node.top_region_end() - node.top_region_src()};
+			if(area_of(top.extent) > 0 && top.contains(rect)){
+				current = child_at_(current, top.src);
 				continue;
 			}
+			return invalid_node;
+		}
+	}
 
-			const extent_type candidate_extent = outer_is_x
-				? extent_type{outer_size, outer->minor}
-				: extent_type{outer->minor, outer_size};
-			const extent_type slack = candidate_extent - size;
+	/**
+	 * @brief Release @p owner and merge it with its free neighbours.
+	 *
+	 * @throw whatever the allocator throws while recording the dirty rect, before anything is released.
+	 */
+	extent_type deallocate_local_(split_point& owner){
+		if(track_dirty_.value) add_dirty_({owner.bot_lft, owner.body_extent()});
+		remain_area_.value += area_of(owner.body_extent());
+		if(owner.split.x == used_bounds_.value.x || owner.split.y == used_bounds_.value.y){
+			used_bounds_stale_ = true;
+		}
+		return owner.mark_idle(*this);
+	}
 
-			node_choice candidate{
-				.point = outer->point,
-				.extent = candidate_extent,
-				.area = candidate_extent.as<large_size_type>().area(),
-				.max_slack = std::max(slack.x, slack.y),
-				.min_slack = std::min(slack.x, slack.y),
-			};
+	/**
+	 * @brief Give the parked requests that fit in @p freed their allocation and resume them, oldest first.
+	 */
+	void wake_waiters_(const extent_type freed){
+		if(waiters_.count == 0) return;
+
+		allocation_awaiter* ready{};
+		allocation_awaiter* ready_tail{};
+		const auto last = std::min(waiter_index::list_of(freed), waiters_.lists.size() - 1);
+		for(std::size_t i = 0; i <= last; ++i){
+			for(auto* waiter = waiters_.lists[i].head; waiter;){
+				auto* next = waiter->next_;
+				if(!waiter->extent_.beyond(freed)){
+					split_point* node{};
+					try{
+						// the request was counted when first made
+						node = place_best_(waiter->extent_);
+					} catch(...){
+						// this and the remaining waiters stay parked, the ones already served still resume
+						resume_chain_(ready);
+						throw;
+					}
+					if(node){
+						waiter->point_ = node->bot_lft;
+						waiters_.erase(*waiter);
+						(ready_tail ? ready_tail->next_ : ready) = waiter;
+						ready_tail = waiter;
+					}
+				}
+				waiter = next;
+			}
+		}
+		resume_chain_(ready);
+	}
 
-			if(better_choice_(candidate, best)){
-				best = candidate;
+	/**
+	 * @brief Resume the unlinked awaiters chained through next_.
+	 *
+	 * A resumed coroutine may use the allocator again and destroy its awaiter, so the chain is read ahead.
+	 */
+	static void resume_chain_(allocation_awaiter* ready) noexcept{
+		while(ready){
+			auto* waiter = ready;
+			ready = waiter->next_;
+			waiter->next_ = nullptr;
+			waiter->continuation_.resume();
+		}
+	}
+
+	/**
+	 * @brief Record a changed rectangle, merging it with pending ones whenever their union is exactly a rectangle.
+	 */
+	void add_dirty_(region rect){
+		for(std::size_t i = 0; i < dirty_.size();){
+			const region& pending = dirty_[i];
+			if(pending.contains(rect)) return;
+
+			const auto pending_end = pending.end();
+			const auto rect_end = rect.end();
+			const bool same_columns = pending.src.x == rect.src.x && pending_end.x == rect_end.x
+				&& pending.src.y <= rect_end.y && rect.src.y <= pending_end.y;
+			const bool same_rows = pending.src.y == rect.src.y && pending_end.y == rect_end.y
+				&& pending.src.x <= rect_end.x && rect.src.x <= pending_end.x;
+
+			if(rect.contains(pending) || same_columns || same_rows){
+				const point_type src{std::min(pending.src.x, rect.src.x), std::min(pending.src.y, rect.src.y)};
+				const point_type end{std::max(pending_end.x, rect_end.x), std::max(pending_end.y, rect_end.y)};
+				rect = {src, end - src};
+				dirty_[i] = dirty_.back();
+				dirty_.pop_back();
+				// the grown rectangle may now merge with entries already visited
+				i = 0;
+				continue;
+			}
+			++i;
+		}
+		dirty_.push_back(rect);
+	}
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] static bool is_allocated_(const split_point& node) noexcept{
+		return !node.idle && !node.has_body_root;
+	}
+
+	void rescan_used_bounds_() const noexcept{
+		point_type bounds{};
+		for(const auto& node : nodes_){
+			if(!is_allocated_(node)) continue;
+			bounds.x = std::max(bounds.x, node.split.x);
+			bounds.y = std::max(bounds.y, node.split.y);
+		}
+		used_bounds_ = bounds;
+		used_bounds_stale_ = false;
+	}
+
+	/**
+	 * @brief Drop the free strips of the root that span its whole height or width.
+	 *
+	 * @return true if the root changed, in which case the new root may be trimmed further.
+	 */
+	bool trim_root_(){
+		auto& root = nodes_[root_.value];
+		bool trimmed = false;
+
+		if(!root.is_leaf()){
+			const point_type right_src = root.right_region_src();
+			const point_type right_end = root.right_region_end();
+			if(area_of(right_end - right_src) > 0 && root.idle_right
+				&& (!root.wide_top_split || root.split.y == root.top_rit.y)){
+				erase_split_(right_src);
+				root.top_rit.x = root.split.x;
+				trimmed = true;
 			}
 
-			outer = tree.upper_bound(make_probe(outer_size, max_size, {max_size, max_size}));
+			const point_type top_src = root.top_region_src();
+			const point_type top_end = root.top_region_end();
+			if(area_of(top_end - top_src) > 0 && root.idle_top
+				&& (root.wide_top_split || root.split.x == root.top_rit.x)){
+				erase_split_(top_src);
+				root.top_rit.y = root.split.y;
+				trimmed = true;
+			}
 		}
 
-		return best;
+		if(root.is_leaf() && root.has_body_root){
+			const auto body_root = body_root_of_(root);
+			auto& body = nodes_[body_root];
+			body.parent = invalid_node;
+			body.is_body_root = false;
+			release_node_slot_(root_.value);
+			root_ = body_root;
+			trimmed = true;
+		}
+
+		return trimmed;
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] bool is_fragment_(const point_type& size) const noexcept{
-		return size.as<large_size_type>().area() <= fragment_threshold_.value;
+	/**
+	 * @brief Direct child of @p owner starting at @p point, reached from the deepest node there.
+	 */
+	[[nodiscard]] node_index child_at_(const node_index owner, const point_type point) const noexcept{
+		const auto* deepest = map_.find(point);
+		assert(deepest != nullptr);
+		auto cur = *deepest;
+		while(nodes_[cur].parent != owner){
+			cur = nodes_[cur].parent;
+			assert(cur != invalid_node);
+		}
+		return cur;
 	}
 
-	node_choice find_best_node_(region_index& tree, const extent_type size){
-		if(size.x >= size.y){
-			return find_best_node_in_tree_<true>(tree.xy, size);
+	[[nodiscard]] node_index body_root_of_(const split_point& owner) const noexcept{
+		assert(owner.has_body_root);
+		return child_at_(index_of_(owner), owner.bot_lft);
+	}
+
+	enum struct child_slot : std::uint8_t{
+		none,
+		body,
+		right,
+		top,
+	};
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] static child_slot slot_of_(const split_point& child) noexcept{
+		if(child.is_body_root) return child_slot::body;
+		return child.is_top_child ? child_slot::top : child_slot::right;
+	}
+
+	/**
+	 * @brief First child of the node at @p owner ordered after @p after, in body, right, top order.
+	 */
+	[[nodiscard]] node_index next_child_(const node_index owner, const child_slot after) const noexcept{
+		const auto& node = nodes_[owner];
+		if(after < child_slot::body && node.has_body_root){
+			return child_at_(owner, node.bot_lft);
 		}
-		return find_best_node_in_tree_<false>(tree.yx, size);
+		if(node.is_leaf()) return invalid_node;
+		if(after < child_slot::right){
+			const point_type src = node.right_region_src();
+			if(area_of(node.right_region_end() - src) > 0) return child_at_(owner, src);
+		}
+		if(after < child_slot::top){
+			const point_type src = node.top_region_src();
+			if(area_of(node.top_region_end() - src) > 0) return child_at_(owner, src);
+		}
+		return invalid_node;
 	}
 
-	node_choice find_best_direct_node_(const extent_type size){
-		auto frag_node = find_best_node_(frag_nodes_, size);
-		if(frag_node.point) return frag_node;
-		return find_best_node_(large_nodes_, size);
+	/**
+	 * @brief Depth-first walk over the subtree at @p from without any auxiliary stack.
+	 *
+	 * @param fn called with each visited node; its children are only visited when it returns true.
+	 */
+	template <typename Fn>
+	void visit_subtree_(const node_index from, Fn&& fn) const{
+		if(from == invalid_node) return;
+		node_index cur = from;
+		while(true){
+			if(fn(nodes_[cur])){
+				if(const auto child = next_child_(cur, child_slot::none); child != invalid_node){
+					cur = child;
+					continue;
+				}
+			}
+
+			while(true){
+				if(cur == from) return;
+				const auto parent = nodes_[cur].parent;
+				if(const auto sibling = next_child_(parent, slot_of_(nodes_[cur])); sibling != invalid_node){
+					cur = sibling;
+					break;
+				}
+				cur = parent;
+			}
+		}
 	}
 
-	node_choice find_best_candidate_(const extent_type size){
-		const auto request_area = size.as<large_size_type>().area();
-		node_choice best = find_best_direct_node_(size);
-		if(best.point && best.area == request_area) return best;
-		for(const auto& body_point : body_nodes_){
-			auto* body_node = node_at_(body_point);
-			if(body_node == nullptr || body_node->body_slot == invalid_body_slot) continue;
-			auto& child = body_allocator_at_(body_node->body_slot);
-			if(child.remain_area_.value < request_area) continue;
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] static std::size_t child_position_(const child_slot slot) noexcept{
+		return static_cast<std::size_t>(slot) - 1;
+	}
 
-			auto nested = child.find_best_candidate_(size);
-			if(!nested.point) continue;
+	/**
+	 * @brief First cached child of @p owner at or after @p position, in body, right, top order.
+	 */
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] node_index cached_child_(const node_index owner, std::size_t position) const noexcept{
+		const auto& children = subtree_free_[owner].children;
+		for(; position < children.size(); ++position){
+			if(children[position] != invalid_node) return children[position];
+		}
+		return invalid_node;
+	}
 
-			const point_type child_point = nested.point.value();
-			node_choice candidate = nested;
-			candidate.point = body_node->bot_lft + child_point;
-			candidate.nested_owner = body_node;
-			candidate.nested_point = child_point;
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void queue_summary_(const node_index index) const{
+		if(!subtree_search_.value || index == invalid_node) return;
+		auto& entry = subtree_free_[index];
+		if(entry.queued) return;
+		entry.queued = true;
+		subtree_queue_.push_back(index);
+	}
 
-			if(better_choice_(candidate, best)){
-				best = candidate;
-				if(best.area == request_area) return best;
+	[[nodiscard]] free_staircase subtree_free_of_(const node_index index) const noexcept{
+		// the body plus up to three child staircases
+		std::array<extent_type, 1 + 3 * free_staircase::capacity> extents{};
+		std::size_t count = 0;
+
+		const auto& node = nodes_[index];
+		if(node.in_free_tree) extents[count++] = node.body_extent();
+		for(const auto child : subtree_free_[index].children){
+			if(child == invalid_node) continue;
+			for(const auto step : subtree_free_[child].free.steps){
+				if(step.x == 0) break;
+				extents[count++] = step;
+			}
+		}
+		return free_staircase::of(extents.data(), count);
+	}
+
+	/**
+	 * @brief Fold the queued nodes into the summaries of their ancestors.
+	 */
+	void flush_summaries_() const noexcept{
+		while(!subtree_queue_.empty()){
+			const auto index = subtree_queue_.back();
+			subtree_queue_.pop_back();
+			subtree_free_[index].queued = false;
+
+			// released slots are idle without being free
+			if(nodes_[index].idle && !nodes_[index].in_free_tree) continue;
+			for(auto cur = index; cur != invalid_node; cur = nodes_[cur].parent){
+				const auto free = subtree_free_of_(cur);
+				if(free == subtree_free_[cur].free) break;
+				subtree_free_[cur].free = free;
+			}
+		}
+	}
+
+	/**
+	 * @brief First free node in body, right, top order that holds @p size, skipping every subtree whose
+	 * staircase cannot; invalid_node if there is none.
+	 */
+	[[nodiscard]] node_index find_first_fit_subtree_(const extent_type size) const noexcept{
+		flush_summaries_();
+		const auto from = root_.value;
+		if(from == invalid_node) return invalid_node;
+
+		node_index cur = from;
+		while(true){
+			if(subtree_free_[cur].free.fits(size)){
+				const auto& node = nodes_[cur];
+				if(node.in_free_tree && !size.beyond(node.body_extent())) return cur;
+				if(const auto child = cached_child_(cur, 0); child != invalid_node){
+					cur = child;
+					continue;
+				}
+			}
+
+			while(true){
+				if(cur == from) return invalid_node;
+				const auto parent = nodes_[cur].parent;
+				if(const auto sibling = cached_child_(parent, child_position_(slot_of_(nodes_[cur])) + 1); sibling != invalid_node){
+					cur = sibling;
+					break;
+				}
+				cur = parent;
+			}
+		}
+	}
+
+	/**
+	 * @brief Node whose subtree is cheapest to clear among those whose region can hold @p extent.
+	 *
+	 * Costs are summed bottom-up over a pre-order listing of the tree, which is left in @p order.
+	 */
+	template <typename CostFn, typename NodeList>
+	[[nodiscard]] node_index cheapest_eviction_root_(const extent_type extent, CostFn& cost_fn, NodeList& order) const{
+		using cost_type = std::remove_cvref_t<std::invoke_result_t<CostFn&, const region&>>;
+		using cost_list = std::vector<cost_type, typename std::allocator_traits<allocator_type>::template rebind_alloc<cost_type>>;
+
+		order.clear();
+		visit_subtree_(root_.value, [&](const split_point& node){
+			order.push_back(index_of_(node));
+			return true;
+		});
+
+		// children always follow their parent in pre-order, so a reverse pass sees them first
+		cost_list costs(nodes_.size(), cost_type{}, typename cost_list::allocator_type{allocator_});
+		for(auto it = order.rbegin(); it != order.rend(); ++it){
+			const auto& node = nodes_[*it];
+			if(is_allocated_(node)){
+				costs[*it] += std::invoke(cost_fn, region{node.bot_lft, node.body_extent()});
+			}
+			if(node.parent != invalid_node) costs[node.parent] += costs[*it];
+		}
+
+		node_index best = invalid_node;
+		large_size_type best_area{};
+		for(const auto index : order){
+			const auto& node = nodes_[index];
+			const auto size = node.top_rit - node.bot_lft;
+			if(extent.beyond(size)) continue;
+
+			const auto area = area_of(size);
+			if(best == invalid_node || costs[index] < costs[best] || (!(costs[best] < costs[index]) && area < best_area)){
+				best = index;
+				best_area = area;
 			}
 		}
 		return best;
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] split_point* node_at_(const point_type point) noexcept{
-		auto itr = map_.find(point);
-		if(itr == map_.end()) return nullptr;
-		return &itr->second;
+public:
+	[[nodiscard]] allocator2d() = default;
+
+	[[nodiscard]] explicit allocator2d(const allocator_type& allocator, large_size_type frag_thres = 0)
+		: allocator_(allocator), fragment_threshold_(frag_thres),
+		  nodes_(allocator), map_(allocator),
+		  large_nodes_(allocator), frag_nodes_(allocator), dirty_(allocator),
+		  subtree_free_(allocator), subtree_queue_(allocator){
+	}
+
+	[[nodiscard]] explicit allocator2d(const extent_type extent, large_size_type frag_thres = 0)
+		: extent_(extent), remain_area_(area_of(extent)), fragment_threshold_(frag_thres){
+		init_root_(extent);
+	}
+
+	[[nodiscard]] allocator2d(const allocator_type& allocator, const extent_type extent, large_size_type frag_thres = 0)
+		: allocator_(allocator), extent_(extent), remain_area_(area_of(extent)), fragment_threshold_(frag_thres),
+		  nodes_(allocator), map_(allocator),
+		  large_nodes_(allocator), frag_nodes_(allocator), dirty_(allocator),
+		  subtree_free_(allocator), subtree_queue_(allocator){
+		init_root_(extent);
+	}
+
+	/**
+	 * @brief Build an allocator whose allocations are exactly @p layout, e.g. the output of shelf_packer.
+	 *
+	 * @return nullopt if adopt rejects @p layout.
+	 */
+	[[nodiscard]] static std::optional<allocator2d> from_layout(
+		const allocator_type& allocator, const extent_type extent, std::span<const region> layout, large_size_type frag_thres = 0){
+		allocator2d result{allocator, extent, frag_thres};
+		if(!result.adopt(layout)) return std::nullopt;
+		return result;
+	}
+
+	[[nodiscard]] static std::optional<allocator2d> from_layout(
+		const extent_type extent, std::span<const region> layout, large_size_type frag_thres = 0){
+		return from_layout(allocator_type{}, extent, layout, frag_thres);
+	}
+
+	/**
+	 * @brief Mark the given rects as allocated, splitting the tree around them, e.g. to restore a baked layout.
+	 *
+	 * Rects are grouped by the free region containing them, and the tree inside each region is built in one
+	 * pass by guillotine cuts between its rects, so the free indexes are only touched for the leftover space.
+	 * Every rect can be released with deallocate afterwards.
+	 *
+	 * @return false, leaving the allocator unchanged, if a rect is empty, leaves the extent, overlaps a live
+	 * allocation or another rect, crosses a border of the split tree, or the rects sharing a free region
+	 * cannot be separated by guillotine cuts.
+	 */
+	bool adopt(std::span<const region> rects){
+		if(rects.empty()) return true;
+		if(root_.value == invalid_node || rects.size() >= invalid_node) return false;
+		for(const auto& rect : rects){
+			if(area_of(rect.extent) == 0 || rect.end().beyond(extent_.value)) return false;
+		}
+
+		using index_list = std::vector<node_index, typename std::allocator_traits<allocator_type>::template rebind_alloc<node_index>>;
+		const auto count = rects.size();
+		index_list indices(count * 6, 0, typename index_list::allocator_type{allocator_});
+		const layout_order target{indices.data(), count};
+		const layout_order by_x{indices.data() + count, count};
+		const layout_order by_y{indices.data() + count * 2, count};
+		const layout_order check_x{indices.data() + count * 3, count};
+		const layout_order check_y{indices.data() + count * 4, count};
+		const layout_order scratch{indices.data() + count * 5, count};
+
+		for(node_index i = 0; i < count; ++i){
+			target[i] = free_node_containing_(rects[i]);
+			if(target[i] == invalid_node) return false;
+			by_x[i] = by_y[i] = i;
+		}
+
+		// group by target region, each group ordered by x and by y
+		std::ranges::sort(by_x, {}, [&](const node_index i){ return std::pair{target[i], rects[i].src.x}; });
+		std::ranges::sort(by_y, {}, [&](const node_index i){ return std::pair{target[i], rects[i].src.y}; });
+
+		const auto for_each_group = [&](auto&& fn){
+			for(std::size_t first = 0; first < count;){
+				std::size_t last = first + 1;
+				while(last < count && target[by_x[last]] == target[by_x[first]]) ++last;
+				if(!fn(target[by_x[first]], first, last - first)) return false;
+				first = last;
+			}
+			return true;
+		};
+
+		// validate every group before touching the tree
+		std::ranges::copy(by_x, check_x.begin());
+		std::ranges::copy(by_y, check_y.begin());
+		const bool valid = for_each_group([&](const node_index region_node, const std::size_t first, const std::size_t size){
+			const auto& node = nodes_[region_node];
+			return build_layout_<false>(invalid_node, node.bot_lft, node.split, rects.data(),
+				check_x.subspan(first, size), check_y.subspan(first, size), scratch);
+		});
+		if(!valid) return false;
+
+		for_each_group([&](node_index region_node, const std::size_t first, const std::size_t size){
+			reserve_node_slots_(3);
+			auto& node = nodes_[region_node];
+			if(node.is_leaf()){
+				erase_mark_(node);
+			} else{
+				region_node = index_of_(node.acquire_body(*this));
+			}
+			const auto& leaf = nodes_[region_node];
+			const bool built = build_layout_<true>(region_node, leaf.bot_lft, leaf.top_rit, rects.data(),
+				by_x.subspan(first, size), by_y.subspan(first, size), scratch);
+			assert(built);
+			return built;
+		});
+		return true;
+	}
+
+	/**
+	 * @brief Mark the rect at @p point with @p extent as allocated; see adopt.
+	 */
+	bool reserve(const point_type point, const extent_type extent){
+		const region rect{point, extent};
+		return adopt(std::span{&rect, 1});
+	}
+
+	/**
+	 * @brief Best-fit point for @p extent aligned to @p alignment, inside a single free region; nothing is taken.
+	 *
+	 * Searches the free indexes like allocate, fragments first, and skips the columns and buckets that
+	 * cannot hold @p extent; only regions that can are checked for the alignment. With use_subtree_search,
+	 * which keeps no indexes, every free region is checked. reserve takes the point.
+	 */
+	[[nodiscard]] std::optional<point_type> find_aligned(const extent_type extent, const size_type alignment) const noexcept{
+		if(alignment == 0 || !can_hold_(extent)) return std::nullopt;
+
+		node_choice best{};
+		if(subtree_search_.value){
+			for(const auto& node : nodes_){
+				if(!node.in_free_tree) continue;
+				const auto free = node.body_extent();
+				if(const auto point = aligned_point_(node.bot_lft, free, extent, alignment)){
+					if(const auto candidate = aligned_choice_(*point, free, extent); better_choice_(candidate, best)) best = candidate;
+				}
+			}
+			return best.point;
+		}
+
+		best = find_aligned_node_(frag_nodes_, extent, alignment);
+		if constexpr(!position_independent){
+			if(!best.point){
+				best = extent.x >= extent.y
+					? find_aligned_in_tree_<true>(large_nodes_.xy, extent, alignment)
+					: find_aligned_in_tree_<false>(large_nodes_.yx, extent, alignment);
+			}
+		}
+		return best.point;
+	}
+
+	[[nodiscard]] std::optional<point_type> allocate(const extent_type extent){
+		if(auto* node = allocate_local_(extent)) return node->bot_lft;
+		return std::nullopt;
+	}
+
+	/**
+	 * @brief Like allocate, but may place @p extent rotated by 90 degrees when that fits better or only fits that way.
+	 *
+	 * Both orientations are searched in the fragment index first and then in the large index, and the
+	 * orientation is picked with the same best-fit order as allocate, preferring the requested one on ties.
+	 * With use_subtree_search the rotated orientation is only tried when the requested one does not fit.
+	 * A rotated allocation covers {extent.y, extent.x} and is released with deallocate as usual.
+	 */
+	[[nodiscard]] std::optional<rotatable_allocation> allocate_rotatable(const extent_type extent){
+		observe_request_(extent);
+		repartition_step_();
+		const extent_type swapped{extent.y, extent.x};
+		const bool try_upright = can_hold_(extent);
+		const bool try_rotated = swapped != extent && can_hold_(swapped);
+		if(!try_upright && !try_rotated) return std::nullopt;
+
+		bool rotated = false;
+		std::optional<point_type> point{};
+		if(subtree_search_.value){
+			auto found = try_upright ? find_first_fit_subtree_(extent) : invalid_node;
+			if(found == invalid_node && try_rotated){
+				found = find_first_fit_subtree_(swapped);
+				rotated = found != invalid_node;
+			}
+			if(found != invalid_node) point = nodes_[found].bot_lft;
+		} else{
+			auto candidate = find_best_rotatable_node_(frag_nodes_, extent, try_upright, try_rotated, rotated);
+			if constexpr(!position_independent){
+				if(!candidate.point){
+					candidate = find_best_rotatable_node_(large_nodes_, extent, try_upright, try_rotated, rotated);
+				}
+			}
+			point = candidate.point;
+		}
+		if(!point) return std::nullopt;
+
+		auto* node = place_(point.value(), rotated ? swapped : extent);
+		node->rotated = rotated;
+		return rotatable_allocation{node->bot_lft, rotated};
+	}
+
+	/**
+	 * @brief Whether the live allocation at @p point was placed rotated by allocate_rotatable.
+	 */
+	[[nodiscard]] bool is_rotated(const point_type point) const noexcept{
+		const auto* node = node_at_(point);
+		return node != nullptr && is_allocated_(*node) && node->rotated;
+	}
+
+	/**
+	 * @brief Same as allocate, but returns a handle that can be released without any table lookup.
+	 */
+	[[nodiscard]] std::optional<allocation_handle> allocate_handle(const extent_type extent){
+		if(auto* node = allocate_local_(extent)) return allocation_handle{node->bot_lft, index_of_(*node)};
+		return std::nullopt;
+	}
+
+	/**
+	 * @brief Release the allocation at @p value, then serve the parked allocate_async requests that now fit.
+	 *
+	 * @throw whatever the allocator throws while placing a woken request, after resuming the requests
+	 * already served; the allocator is then left as by a failed allocate.
+	 * @return false if @p value is not the point of a live allocation.
+	 */
+	bool deallocate(const point_type value){
+		auto* owner = node_at_(value);
+		if(owner == nullptr || owner->idle) return false;
+		wake_waiters_(deallocate_local_(*owner));
+		return true;
+	}
+
+	/**
+	 * @brief Like deallocate(point), checked against the node recorded in @p handle.
+	 */
+	bool deallocate(const allocation_handle handle){
+		if(handle.node >= nodes_.size()) return false;
+		auto& owner = nodes_[handle.node];
+		if(owner.idle || owner.has_body_root || owner.bot_lft != handle.point) return false;
+		wake_waiters_(deallocate_local_(owner));
+		return true;
+	}
+
+	/**
+	 * @brief Allocate @p extent, evicting live allocations first if it does not fit.
+	 *
+	 * The evicted set is every allocation inside the split-tree subtree with the lowest summed @p cost_fn
+	 * among those whose region can hold @p extent. Freeing a whole subtree merges it back into one free
+	 * region, so the allocation is guaranteed to succeed, and nothing outside that subtree is touched.
+	 *
+	 * Once the allocation is made, the parked allocate_async requests that fit in what the evictions left
+	 * free are served, as deallocate would serve them.
+	 *
+	 * @param cost_fn called with each live allocation; returns an arithmetic cost such as its age rank.
+	 * @param on_evict called with each evicted allocation right before it is released.
+	 * @return nullopt only if @p extent is empty or exceeds the allocator extent.
+	 */
+	template <std::invocable<const region&> CostFn, std::invocable<const region&> EvictFn>
+	[[nodiscard]] std::optional<point_type> allocate_with_eviction(const extent_type extent, CostFn cost_fn, EvictFn on_evict){
+		if(auto* node = allocate_local_(extent)) return node->bot_lft;
+		if(area_of(extent) == 0 || extent.beyond(extent_.value) || root_.value == invalid_node) return std::nullopt;
+
+		std::vector<node_index, typename std::allocator_traits<allocator_type>::template rebind_alloc<node_index>>
+			scratch{allocator_};
+		const auto victim = cheapest_eviction_root_(extent, cost_fn, scratch);
+		assert(victim != invalid_node);
+
+		scratch.clear();
+		visit_subtree_(victim, [&](const split_point& node){
+			if(is_allocated_(node)) scratch.push_back(index_of_(node));
+			return true;
+		});
+
+		// releasing only ever frees idle nodes, so the collected allocations stay where they are
+		extent_type freed{};
+		for(const auto index : scratch){
+			auto& node = nodes_[index];
+			std::invoke(on_evict, region{node.bot_lft, node.body_extent()});
+			const auto merged = deallocate_local_(node);
+			freed = {std::max(freed.x, merged.x), std::max(freed.y, merged.y)};
+		}
+
+		// the request was counted by the first attempt
+		auto* node = place_best_(extent);
+		assert(node != nullptr);
+		const auto point = node->bot_lft;
+		wake_waiters_(freed);
+		return point;
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] const split_point* node_at_(const point_type point) const noexcept{
-		auto itr = map_.find(point);
-		if(itr == map_.end()) return nullptr;
-		return &itr->second;
+	template <std::invocable<const region&> CostFn>
+	[[nodiscard]] std::optional<point_type> allocate_with_eviction(const extent_type extent, CostFn cost_fn){
+		return allocate_with_eviction(extent, std::move(cost_fn), [](const region&) noexcept{});
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] split_point* parent_node_of_(split_point& node) noexcept{
-		if(node.parent == node.bot_lft) return nullptr;
-		return node_at_(node.parent);
+	/**
+	 * @brief Allocate @p extent once there is room, for use with co_await.
+	 *
+	 * Tries allocate right away. If that fails the request is parked, costing nothing until deallocate or
+	 * grow frees a region that can hold it; the allocation is then made and the coroutine resumed inside
+	 * that call, after the allocator is consistent again. Parked requests are served oldest first within
+	 * each size class, smaller classes first.
+	 *
+	 * Moving the allocator takes its parked requests along. Destroying it leaves them suspended, so
+	 * cancel_waiters should run first.
+	 *
+	 * @return an awaitable yielding the point, or nullopt for an empty extent or a cancelled request.
+	 */
+	[[nodiscard]] allocation_awaiter allocate_async(const extent_type extent) noexcept requires (!position_independent){
+		return allocation_awaiter{*this, extent};
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] const split_point* parent_node_of_(const split_point& node) const noexcept{
-		if(node.parent == node.bot_lft) return nullptr;
-		return node_at_(node.parent);
+	/**
+	 * @brief Resume every parked allocate_async request with nullopt.
+	 */
+	void cancel_waiters() noexcept{
+		allocation_awaiter* ready{};
+		allocation_awaiter* ready_tail{};
+		for(auto& list : waiters_.lists){
+			while(auto* waiter = list.head){
+				waiters_.erase(*waiter);
+				(ready_tail ? ready_tail->next_ : ready) = waiter;
+				ready_tail = waiter;
+			}
+		}
+		resume_chain_(ready);
 	}
 
-	void mark_size_(const point_type src, const point_type dst){
-		const auto size = dst - src;
-		auto node_itr = map_.find(src);
-		assert(node_itr != map_.end());
-		auto& node = node_itr->second;
+	/**
+	 * @brief Number of parked allocate_async requests.
+	 */
+	[[nodiscard]] std::size_t waiter_count() const noexcept{
+		return waiters_.count;
+	}
 
-		if(is_fragment_(size)){
-			node.free_xy = frag_nodes_.xy.insert({size.x, size.y, src});
-			node.free_yx = frag_nodes_.yx.insert({size.y, size.x, src});
-			node.in_fragment_tree = true;
+	/**
+	 * @brief Enlarge the allocator in place. Existing allocations keep their points, so a backing texture
+	 * only needs its old content copied over.
+	 *
+	 * @return false if @p new_extent is smaller than the current extent in either dimension.
+	 */
+	bool grow(const extent_type new_extent){
+		const auto old_extent = extent_.value;
+		if(old_extent.beyond(new_extent)) return false;
+		if(new_extent == old_extent) return true;
+
+		if(root_.value == invalid_node){
+			// an empty or fully trimmed allocator only gets a root once it has area
+			if(area_of(new_extent) == 0){
+				extent_ = new_extent;
+				return true;
+			}
+			init_root_(new_extent);
+		} else if(auto& root = nodes_[root_.value]; root.idle && root.is_leaf()){
+			erase_mark_(root);
+			root.top_rit = new_extent;
+			root.split = new_extent;
+			mark_size_(root);
 		} else{
-			node.free_xy = large_nodes_.xy.insert({size.x, size.y, src});
-			node.free_yx = large_nodes_.yx.insert({size.y, size.x, src});
-			node.in_fragment_tree = false;
+			wrap_root_(new_extent);
 		}
 
-		node.in_free_tree = true;
+		remain_area_.value += area_of(new_extent) - area_of(old_extent);
+		extent_ = new_extent;
+		wake_waiters_(new_extent);
+		return true;
 	}
 
-	void add_split_(const point_type parent, const point_type src, const point_type dst){
-		auto [node_itr, inserted] = map_.try_emplace(src, parent, src, dst);
-		assert(inserted);
-		auto& node = node_itr->second;
-
-		node.is_top_child = parent != src && src.x == parent.x;
+	/**
+	 * @brief Shrink the extent by dropping the free strips along the top and right edges of the root.
+	 *
+	 * Only strips that are entirely free and span the whole root are removed, so the result may still
+	 * be larger than used_bounds(). An allocator with nothing allocated trims to an empty extent, which
+	 * grow enlarges again like a default constructed one.
+	 *
+	 * @return the new extent.
+	 */
+	extent_type trim(){
+		if(root_.value == invalid_node) return extent_.value;
+
+		while(trim_root_()){}
+
+		if(auto& root = nodes_[root_.value]; root.idle && root.is_leaf()){
+			erase_mark_(root);
+			map_.erase(root.bot_lft);
+			release_node_slot_(root_.value);
+			root_ = invalid_node;
+			remain_area_ = 0;
+			extent_ = extent_type{};
+			return extent_.value;
+		}
 
-		mark_size_(src, dst);
+		const auto new_extent = nodes_[root_.value].top_rit;
+		remain_area_.value -= area_of(extent_.value) - area_of(new_extent);
+		extent_ = new_extent;
+		return new_extent;
 	}
 
-	void erase_split_(const point_type src, const point_type dst){
-		erase_mark_(src, dst);
-		map_.erase(src);
+	/**
+	 * @brief Lazy view over the live allocations, in no particular order.
+	 */
+	[[nodiscard]] auto allocations() const noexcept{
+		return nodes_
+			| std::views::filter([](const split_point& node){ return is_allocated_(node); })
+			| std::views::transform([](const split_point& node){ return region{node.bot_lft, node.body_extent()}; });
 	}
 
-	void erase_mark_(const point_type src, const point_type dst){
-		(void)dst;
-		auto node_itr = map_.find(src);
-		if(node_itr == map_.end()) return;
-		auto& node = node_itr->second;
-		if(!node.in_free_tree) return;
-
-		region_index& index = node.in_fragment_tree ? frag_nodes_ : large_nodes_;
-
-		index.xy.erase(node.free_xy);
-		index.yx.erase(node.free_yx);
-
-		node.clear_free_tree_state();
+	/**
+	 * @brief Slots in the node storage, recycled ones included; the length of an allocations or free_regions scan.
+	 */
+	[[nodiscard]] std::size_t node_count() const noexcept{
+		return nodes_.size();
 	}
 
-	void init_threshold_(const extent_type extent){
-		if(!fragment_threshold_.value){
-			fragment_threshold_ = std::max<large_size_type>(extent.as<large_size_type>().area() / 64, 96 * 96);
-		}
+	/**
+	 * @brief Lazy view over the free regions held in the free indexes, in no particular order.
+	 *
+	 * Regions are maximal only along the split tree, so adjacent free regions are not merged.
+	 */
+	[[nodiscard]] auto free_regions() const noexcept{
+		return nodes_
+			| std::views::filter([](const split_point& node){ return node.in_free_tree; })
+			| std::views::transform([](const split_point& node){ return region{node.bot_lft, node.body_extent()}; });
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] large_size_type total_area_() const noexcept{
-		return extent_.value.template as<large_size_type>().area();
+	/**
+	 * @brief Call @p fn with every live allocation overlapping @p area.
+	 *
+	 * Subtrees whose region does not overlap @p area are skipped.
+	 */
+	template <typename Fn>
+	void query(const region& area, Fn&& fn) const{
+		visit_subtree_(root_.value, [&](const split_point& node){
+			if(!region{node.bot_lft, node.top_rit - node.bot_lft}.overlaps(area)) return false;
+			if(is_allocated_(node)){
+				const region body{node.bot_lft, node.body_extent()};
+				if(body.overlaps(area)) fn(body);
+			}
+			return true;
+		});
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void register_body_node_(split_point* node){
-		const auto point = node->bot_lft;
-		if(std::ranges::find(body_nodes_, point) != body_nodes_.end()) return;
-		body_nodes_.push_back(point);
+	[[nodiscard]] region_list_type query(const region& area) const{
+		region_list_type result{dirty_.get_allocator()};
+		query(area, [&](const region& rect){ result.push_back(rect); });
+		return result;
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void unregister_body_node_(split_point* node) noexcept{
-		std::erase(body_nodes_, node->bot_lft);
+	/**
+	 * @brief Let the fragment threshold follow the request sizes actually seen; off by default.
+	 *
+	 * Request areas are counted in a decaying histogram with one bucket per power of two, and every 256
+	 * requests the threshold moves to 4 to 8 times the median request area. The fragment index then holds
+	 * the regions sized for the common requests while larger ones stay whole. Free regions left on the
+	 * wrong side of a moved threshold are re-indexed a few nodes per allocation. Disabling keeps the
+	 * current threshold.
+	 */
+	void adapt_fragment_threshold(const bool enabled) noexcept{
+		adaptive_threshold_ = enabled;
 	}
 
-	std::optional<point_type> allocate_local_(const extent_type extent){
-		if(extent.area() == 0){
-			return std::nullopt;
-		}
-		if(extent.beyond(extent_.value)) return std::nullopt;
-
-		const auto area = extent.as<large_size_type>().area();
-		if(remain_area_.value < area) return std::nullopt;
-
-		const auto candidate = find_best_candidate_(extent);
-		if(!candidate.point) return std::nullopt;
-
-		if(candidate.nested_owner != nullptr){
-			auto& nested_alloc = candidate.nested_owner->body_slot != invalid_body_slot
-				? body_allocator_at_(candidate.nested_owner->body_slot)
-				: candidate.nested_owner->ensure_body_allocator(*this);
-			auto nested_point = nested_alloc.allocate_local_(extent);
-			assert(nested_point.has_value());
-			candidate.nested_owner->idle = false;
-			auto [itr, inserted] = allocations_.try_emplace(
-				candidate.point.value(),
-				allocation_record{candidate.nested_owner->bot_lft, nested_point.value(), extent, true});
-			assert(inserted);
-			(void)itr;
+	[[nodiscard]] large_size_type fragment_threshold() const noexcept{ return fragment_threshold_.value; }
+
+	/**
+	 * @brief Size the internal storage up front so that allocate and deallocate stop reaching the allocator.
+	 *
+	 * Sizes the node pool, the point map, spare nodes for both region trees, and the per-node tables of the
+	 * fragment index or of the subtree search for @p max_nodes split tree nodes. With use_subtree_search,
+	 * allocate, allocate_rotatable, allocate_handle and deallocate then make no allocations from the first
+	 * call on, as long as the tree stays within @p max_nodes.
+	 *
+	 * The free indexes, the default engine, only give that guarantee after a warm-up: fragment groups are
+	 * created and grown per extent on demand and keep their storage, so the first cycles that reach the peak
+	 * of the fragment mix still allocate. take_dirty still hands its buffer to the caller, and
+	 * allocate_with_eviction still builds temporary lists.
+	 *
+	 * @param max_allocations live allocations to plan for; max_nodes is raised to 3 * max_allocations + 1,
+	 * one node per allocation plus the two regions it splits off.
+	 * @param max_nodes split tree nodes to plan for, for churn that leaves deeper trees behind.
+	 */
+	void reserve_capacity(const std::size_t max_allocations, std::size_t max_nodes = 0){
+		max_nodes = std::max(max_nodes, max_allocations * 3 + 1);
+		// place_ makes room for three more nodes before taking any
+		nodes_.reserve(max_nodes + 3);
+		// the map grows to twice the entries it needs when full
+		map_.reserve(max_nodes * 2);
+		if(subtree_search_.value){
+			if(subtree_free_.size() < nodes_.capacity()) subtree_free_.resize(nodes_.capacity());
+			subtree_queue_.reserve(max_nodes);
 		} else{
-			auto node_itr = map_.find(candidate.point.value());
-			assert(node_itr != map_.end());
-			auto& node = node_itr->second;
-			if(node.is_leaf()){
-				node.acquire_and_split(*this, extent);
-				auto [itr, inserted] = allocations_.try_emplace(
-					candidate.point.value(), allocation_record{node.bot_lft, {}, extent, false});
-				assert(inserted);
-				(void)itr;
-			} else{
-				auto& nested_alloc = node.ensure_body_allocator(*this);
-				auto nested_point = nested_alloc.allocate_local_(extent);
-				assert(nested_point.has_value());
-				node.idle = false;
-				auto [itr, inserted] = allocations_.try_emplace(
-					candidate.point.value(),
-					allocation_record{node.bot_lft, nested_point.value(), extent, true});
-				assert(inserted);
-				(void)itr;
-			}
+			large_nodes_.reserve(max_nodes);
+			frag_nodes_.reserve(max_nodes);
 		}
-
-		remain_area_.value -= area;
-		return candidate.point;
 	}
 
-	bool deallocate_local_(const point_type value) noexcept{
-		const auto itr = allocations_.find(value);
-		if(itr == allocations_.end()) return false;
-
-		const allocation_record record = itr->second;
-		allocations_.erase(itr);
-		remain_area_.value += record.extent.area();
-
-		if(record.nested){
-			auto* owner = node_at_(record.owner_point);
-			assert(owner != nullptr);
-			assert(owner->body_slot != invalid_body_slot);
-			auto& child = body_allocator_at_(owner->body_slot);
-			const bool success = child.deallocate_local_(record.nested_point);
-			assert(success);
-			(void)success;
-			if(child.remain_area() == child.extent().area()){
-				owner->mark_body_idle(*this);
+	/**
+	 * @brief Switch between the best-fit free indexes and a top-down search of the split tree; off by default.
+	 *
+	 * With the subtree search on, every node caches a small staircase of the free extents below it, refreshed
+	 * along the ancestor walk of each split and merge, and allocate descends from the root in body, right,
+	 * top order while skipping the subtrees that cannot fit. Placement becomes first fit in that order,
+	 * which keeps allocations close to the origin, and the free indexes are dropped so no sorted index is
+	 * updated per split. The fragment threshold, adaptive or not, only applies to the indexes.
+	 * Switching rebuilds the target structure in O(n).
+	 */
+	void use_subtree_search(const bool enabled){
+		if(enabled == subtree_search_.value) return;
+		repartition_cursor_ = invalid_node;
+
+		if(enabled){
+			if constexpr(!position_independent){
+				large_nodes_.xy.clear();
+				large_nodes_.yx.clear();
 			}
+			frag_nodes_ = fragment_index{allocator_};
+			subtree_search_ = true;
+			subtree_free_.assign(nodes_.capacity(), subtree_entry{});
+			visit_subtree_(root_.value, [&](const split_point& node){
+				const auto index = index_of_(node);
+				if(node.parent != invalid_node){
+					subtree_free_[node.parent].children[child_position_(slot_of_(node))] = index;
+				}
+				if(node.in_free_tree){
+					nodes_[index].in_fragment_tree = false;
+					queue_summary_(index);
+				}
+				return true;
+			});
+			flush_summaries_();
 		} else{
-			auto* owner = node_at_(record.owner_point);
-			assert(owner != nullptr);
-			owner->mark_idle(*this);
+			subtree_search_ = false;
+			subtree_free_.clear();
+			subtree_queue_.clear();
+			for(auto& node : nodes_){
+				if(node.in_free_tree) mark_size_(node);
+			}
 		}
-		return true;
 	}
 
-public:
-	[[nodiscard]] allocator2d() = default;
+	[[nodiscard]] bool uses_subtree_search() const noexcept{ return subtree_search_.value; }
 
-	[[nodiscard]] explicit allocator2d(const allocator_type& allocator, large_size_type frag_thres = 0)
-		: allocator_(allocator), fragment_threshold_(frag_thres),
-		  map_(allocator), allocations_(allocator),
-		  large_nodes_(allocator), frag_nodes_(allocator), body_nodes_(allocator){
+	/**
+	 * @brief Start or stop recording the rectangles touched by allocate and deallocate.
+	 *
+	 * Disabling the tracking also drops the pending rectangles.
+	 */
+	void track_dirty(const bool enabled) noexcept{
+		track_dirty_ = enabled;
+		if(!enabled) dirty_.clear();
 	}
 
-	[[nodiscard]] explicit allocator2d(const extent_type extent, large_size_type frag_thres = 0)
-		: extent_(extent), remain_area_(extent.area()), fragment_threshold_(frag_thres){
-		init_threshold_(extent);
-		add_split_({}, {}, extent);
+	/**
+	 * @brief Coalesced rectangles allocated or released since the last call; the pending list is left empty.
+	 */
+	[[nodiscard]] region_list_type take_dirty(){
+		region_list_type result{dirty_.get_allocator()};
+		result.swap(dirty_);
+		return result;
 	}
 
-	[[nodiscard]] allocator2d(const allocator_type& allocator, const extent_type extent, large_size_type frag_thres = 0)
-		: allocator_(allocator), extent_(extent), remain_area_(extent.area()), fragment_threshold_(frag_thres),
-		  map_(allocator), allocations_(allocator),
-		  large_nodes_(allocator), frag_nodes_(allocator), body_nodes_(allocator){
-		init_threshold_(extent);
-		add_split_({}, {}, extent);
+	/**
+	 * @brief Smallest extent, anchored at the origin, that contains every live allocation.
+	 */
+	[[nodiscard]] extent_type used_bounds() const noexcept{
+		if(used_bounds_stale_.value) rescan_used_bounds_();
+		return used_bounds_.value;
 	}
 
-	[[nodiscard]] std::optional<point_type> allocate(const extent_type extent){
-		return allocate_local_(extent);
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] extent_type extent() const noexcept{ return extent_.value; }
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] large_size_type remain_area() const noexcept{ return remain_area_.value; }
+
+	/**
+	 * @brief Width of the widest and height of the tallest free region, not necessarily the same region.
+	 *
+	 * No extent beyond it can be allocated, so it serves as a constant time rejection test.
+	 */
+	[[nodiscard]] extent_type max_free_extent() const noexcept{
+		if(subtree_search_.value){
+			if(root_.value == invalid_node) return {};
+			flush_summaries_();
+			return subtree_free_[root_.value].free.bounds();
+		}
+
+		extent_type result{};
+		if constexpr(!position_independent){
+			if(!large_nodes_.xy.empty()) result.x = large_nodes_.xy.rbegin()->major;
+			if(!large_nodes_.yx.empty()) result.y = large_nodes_.yx.rbegin()->major;
+		}
+		const auto fragments = frag_nodes_.max_extent();
+		return {std::max(result.x, fragments.x), std::max(result.y, fragments.y)};
 	}
 
-	bool deallocate(const point_type value) noexcept{
-		return deallocate_local_(value);
+	[[nodiscard]] memory_usage_report memory_usage() const noexcept{
+		return {
+			.nodes = nodes_.capacity() * sizeof(split_point),
+			.node_map = map_.memory_usage(),
+			.region_indexes = large_nodes_.memory_usage()
+			+ frag_nodes_.memory_usage()
+			+ subtree_free_.capacity() * sizeof(subtree_entry) + subtree_queue_.capacity() * sizeof(node_index),
+		};
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] extent_type extent() const noexcept{ return extent_.value; }
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] large_size_type remain_area() const noexcept{ return remain_area_.value; }
+	/**
+	 * @brief Check the structural invariants of the split tree and its indexes; O(n), meant for tests and debugging.
+	 *
+	 * Verifies node geometry and parent links, that every live point maps to its deepest node, that the
+	 * idle flags agree with the children, that exactly the idle nodes sit in the matching free index, and
+	 * that the free and allocated areas add up to the extent. With use_subtree_search the indexes must be
+	 * empty and every subtree summary up to date instead.
+	 */
+	[[nodiscard]] bool validate() const{
+		if(root_.value == invalid_node){
+			return map_.size() == 0 && remain_area_.value == 0 && large_index_size_() == 0 && frag_nodes_.count.value == 0;
+		}
+		if(root_.value >= nodes_.size()) return false;
+
+		enum : std::uint8_t{
+			dead = 1 << 0,
+			body_child = 1 << 1,
+			right_child = 1 << 2,
+			top_child = 1 << 3,
+		};
+
+		std::vector<std::uint8_t, typename std::allocator_traits<allocator_type>::template rebind_alloc<std::uint8_t>>
+			state(nodes_.size(), 0, allocator_);
+
+		for(auto slot = free_node_.value; slot != invalid_node; slot = nodes_[slot].parent){
+			if(slot >= nodes_.size() || state[slot] & dead) return false;
+			state[slot] |= dead;
+		}
+		if(state[root_.value] & dead) return false;
+
+		const auto in_bounds = [](const point_type lo, const point_type p, const point_type hi){
+			return lo.x <= p.x && lo.y <= p.y && p.x <= hi.x && p.y <= hi.y;
+		};
+
+		// geometry, parent links and the point map
+		std::size_t deepest_count{};
+		for(node_index index = 0; index < nodes_.size(); ++index){
+			if(state[index] & dead) continue;
+			const auto& node = nodes_[index];
+			if(!in_bounds(node.bot_lft, node.split, node.top_rit) || node.split.x == node.bot_lft.x || node.split.y == node.bot_lft.y){
+				return false;
+			}
+
+			if(index == root_.value){
+				if(node.parent != invalid_node || node.is_body_root) return false;
+				if(node.bot_lft != point_type{} || node.top_rit != extent_.value) return false;
+			} else{
+				if(node.parent >= nodes_.size() || state[node.parent] & dead) return false;
+				const auto& parent = nodes_[node.parent];
+				if(parent.is_leaf()) return false;
+
+				point_type src, end;
+				std::uint8_t slot;
+				if(node.is_body_root){
+					if(!parent.has_body_root || parent.idle) return false;
+					src = parent.bot_lft;
+					end = parent.split;
+					slot = body_child;
+				} else if(node.is_top_child){
+					if(parent.idle_top != (node.idle && node.is_leaf())) return false;
+					src = parent.top_region_src();
+					end = parent.top_region_end();
+					slot = top_child;
+				} else{
+					if(parent.idle_right != (node.idle && node.is_leaf())) return false;
+					src = parent.right_region_src();
+					end = parent.right_region_end();
+					slot = right_child;
+				}
+				if(node.bot_lft != src || node.top_rit != end || state[node.parent] & slot) return false;
+				state[node.parent] |= slot;
+			}
+
+			const auto* deepest = map_.find(node.bot_lft);
+			if(deepest == nullptr || *deepest >= nodes_.size()) return false;
+			if(node.has_body_root){
+				// only body roots share a point with their parent, and children have strictly smaller regions
+				auto cur = *deepest;
+				for(std::size_t steps = 0; cur != index; ++steps){
+					if(steps == nodes_.size() || state[cur] & dead || !nodes_[cur].is_body_root) return false;
+					if(nodes_[cur].bot_lft != node.bot_lft) return false;
+					cur = nodes_[cur].parent;
+				}
+			} else{
+				if(*deepest != index) return false;
+				++deepest_count;
+			}
+		}
+		if(deepest_count != map_.size()) return false;
+
+		// children, idle flags and the free indexes
+		std::size_t free_count{};
+		std::size_t fragment_count{};
+		large_size_type free_area{};
+		large_size_type used_area{};
+		point_type bounds{};
+		for(node_index index = 0; index < nodes_.size(); ++index){
+			if(state[index] & dead) continue;
+			const auto& node = nodes_[index];
+
+			const bool has_right = !node.is_leaf() && area_of(node.right_region_end() - node.right_region_src()) > 0;
+			const bool has_top = !node.is_leaf() && area_of(node.top_region_end() - node.top_region_src()) > 0;
+			if(static_cast<bool>(state[index] & body_child) != node.has_body_root) return false;
+			if(static_cast<bool>(state[index] & right_child) != has_right) return false;
+			if(static_cast<bool>(state[index] & top_child) != has_top) return false;
+			if(!has_right && !node.idle_right) return false;
+			if(!has_top && !node.idle_top) return false;
+
+			if(node.has_body_root && node.idle) return false;
+			// an idle node whose children are idle leaves should have been merged
+			if(node.idle && !node.is_leaf() && node.is_split_idle()) return false;
+			if(node.in_free_tree != node.idle) return false;
+
+			const auto body = node.body_extent();
+			const auto body_area = area_of(body);
+			if(node.in_free_tree){
+				if(subtree_search_.value){
+					if(node.in_fragment_tree) return false;
+				} else if(node.in_fragment_tree != is_fragment_(body) && !repartition_pending_(index)){
+					return false;
+				} else if(node.in_fragment_tree){
+					const auto bucket = fragment_index::bucket_of(body);
+					if(bucket >= frag_nodes_.buckets.size() || index >= frag_nodes_.slots.size()) return false;
+					const auto& entries = frag_nodes_.buckets[bucket];
+					const auto [group, position] = frag_nodes_.slots[index];
+					if(group >= entries.groups.size() || position >= entries.groups[group].size()) return false;
+					if(entries.widths[group] != body.x || entries.heights[group] != body.y) return false;
+					const auto& heap = entries.groups[group];
+					if(heap[position].node != index || heap[position].point != node.bot_lft) return false;
+					if(position > 0 && heap[position].before(heap[(position - 1) / 2])) return false;
+					if(body.beyond(entries.max_extent)) return false;
+					++fragment_count;
+				} else if constexpr(!position_independent){
+					const free_entry_compare less{};
+					const free_entry xy{body.x, body.y, node.bot_lft};
+					const free_entry yx{body.y, body.x, node.bot_lft};
+					if(less(*node.free_xy, xy) || less(xy, *node.free_xy)) return false;
+					if(less(*node.free_yx, yx) || less(yx, *node.free_yx)) return false;
+				}
+				++free_count;
+				free_area += body_area;
+			} else if(!node.has_body_root){
+				used_area += body_area;
+				bounds.x = std::max(bounds.x, node.split.x);
+				bounds.y = std::max(bounds.y, node.split.y);
+			}
+		}
+
+		if constexpr(!position_independent){
+			if(large_nodes_.xy.size() != large_nodes_.yx.size()) return false;
+		}
+		if(frag_nodes_.count.value != fragment_count) return false;
+		if(large_index_size_() + fragment_count != (subtree_search_.value ? 0 : free_count)) return false;
+		if(free_area != remain_area_.value || free_area + used_area != total_area_()) return false;
+		if(!used_bounds_stale_.value && used_bounds_.value != bounds) return false;
+
+		if(subtree_search_.value){
+			if(subtree_free_.size() < nodes_.size()) return false;
+			flush_summaries_();
+			for(node_index index = 0; index < nodes_.size(); ++index){
+				if(state[index] & dead) continue;
+				decltype(subtree_entry::children) children{invalid_node, invalid_node, invalid_node};
+				for(auto child = next_child_(index, child_slot::none); child != invalid_node;
+				    child = next_child_(index, slot_of_(nodes_[child]))){
+					children[child_position_(slot_of_(nodes_[child]))] = child;
+				}
+				if(subtree_free_[index].children != children) return false;
+				if(subtree_free_[index].free != subtree_free_of_(index)) return false;
+			}
+		}
+		return true;
+	}
 
 	allocator2d(allocator2d&& other) = default;
 
@@ -787,196 +3717,680 @@ protected:
 	}
 };
 
-template <typename Alloc>
-struct allocator2d<Alloc>::body_pool{
-	using allocator_pointer_vector_type = std::vector<
-		allocator2d*,
-		typename std::allocator_traits<allocator_type>::template rebind_alloc<allocator2d*>>;
-	using free_slots_type = std::vector<
-		body_slot_type,
-		typename std::allocator_traits<allocator_type>::template rebind_alloc<body_slot_type>>;
-	using body_allocator_type = typename std::allocator_traits<allocator_type>::template rebind_alloc<allocator2d>;
-	using body_allocator_traits = std::allocator_traits<body_allocator_type>;
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename Alloc = std::allocator<std::byte>, typename T = std::uint32_t>
+struct allocator2d_checked : allocator2d<Alloc, T>{
+	[[nodiscard]] allocator2d_checked(const typename allocator2d<Alloc, T>::allocator_type& allocator,
+	                                  typename allocator2d<Alloc, T>::large_size_type frag_thres = 0)
+		: allocator2d<Alloc, T>(allocator, frag_thres){
+	}
+
+	[[nodiscard]] allocator2d_checked(const typename allocator2d<Alloc, T>::extent_type& extent,
+	                                  typename allocator2d<Alloc, T>::large_size_type frag_thres = 0)
+		: allocator2d<Alloc, T>(extent, frag_thres){
+	}
+
+	[[nodiscard]] allocator2d_checked(const typename allocator2d<Alloc, T>::allocator_type& allocator,
+	                                  const typename allocator2d<Alloc, T>::extent_type& extent,
+	                                  typename allocator2d<Alloc, T>::large_size_type frag_thres = 0)
+		: allocator2d<Alloc, T>(allocator, extent, frag_thres){
+	}
+
+	[[nodiscard]] allocator2d_checked() = default;
+
+	~allocator2d_checked(){
+		this->check_leak_();
+	}
+
+	allocator2d_checked(allocator2d_checked&& other) noexcept(std::is_nothrow_move_constructible_v<allocator2d<Alloc, T>>) = default;
+
+	allocator2d_checked& operator=(allocator2d_checked&& other) noexcept(std::is_nothrow_move_assignable_v<allocator2d<Alloc, T>>){
+		if(this == &other) return *this;
+		this->check_leak_();
+		allocator2d<Alloc, T>::operator=(std::move(other));
+		return *this;
+	}
+
+protected:
+	allocator2d_checked& operator=(const allocator2d_checked& other) = default;
+	allocator2d_checked(const allocator2d_checked& other) = default;
+};
+
+/**
+ * @brief Static bulk packer placing rects on horizontal shelves, for layouts packed once and then seeded
+ * into an allocator2d through allocator2d::from_layout.
+ *
+ * Every shelf spans the full width and rects sit side by side on it, so the layout always splits by
+ * guillotine cuts and maps onto the split tree exactly. A rect goes to the fitting shelf that wastes the
+ * least height; pack_all sorts by decreasing height first, which is what makes shelves dense.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename Alloc = std::allocator<std::byte>, typename T = std::uint32_t>
+struct shelf_packer{
+	using size_type = typename allocator2d<Alloc, T>::size_type;
+	using extent_type = typename allocator2d<Alloc, T>::extent_type;
+	using point_type = typename allocator2d<Alloc, T>::point_type;
+	using region = typename allocator2d<Alloc, T>::region;
+	using region_list_type = typename allocator2d<Alloc, T>::region_list_type;
+	using allocator_type = Alloc;
+	using position_list_type = std::vector<
+		std::optional<point_type>,
+		typename std::allocator_traits<Alloc>::template rebind_alloc<std::optional<point_type>>>;
+
+private:
+	struct shelf{
+		size_type y{};
+		size_type height{};
+		size_type used{};
+	};
+
+	using shelf_list = std::vector<shelf, typename std::allocator_traits<Alloc>::template rebind_alloc<shelf>>;
+
+	extent_type extent_{};
+	size_type top_{};
+	shelf_list shelves_{};
+	region_list_type regions_{};
 
-	MO_YANXI_ALLOCATOR_2D_NO_UNIQUE_ADDRESS allocator_type allocator;
-	allocator_pointer_vector_type allocators;
-	free_slots_type free_slots;
+public:
+	[[nodiscard]] constexpr shelf_packer() = default;
 
-	explicit body_pool(const allocator_type& allocator)
-		: allocator(allocator), allocators(allocator), free_slots(allocator){
+	[[nodiscard]] constexpr explicit shelf_packer(const extent_type extent, const allocator_type& allocator = {})
+		: extent_(extent), shelves_(allocator), regions_(allocator){
 	}
 
-	body_pool(const body_pool&) = delete;
-	body_pool& operator=(const body_pool&) = delete;
+	/**
+	 * @brief Place a single rect in arrival order.
+	 */
+	constexpr std::optional<point_type> pack(const extent_type size){
+		if(size.x == 0 || size.y == 0 || size.beyond(extent_)) return std::nullopt;
+
+		shelf* best = nullptr;
+		for(auto& candidate : shelves_){
+			if(candidate.height < size.y || extent_.x - candidate.used < size.x) continue;
+			if(!best || candidate.height < best->height) best = &candidate;
+			if(best->height == size.y) break;
+		}
 
-	~body_pool(){
-		for(auto*& allocator : allocators){
-			if(allocator == nullptr) continue;
-			destroy_allocator(allocator);
-			allocator = nullptr;
+		if(!best){
+			if(extent_.y - top_ < size.y) return std::nullopt;
+			best = &shelves_.emplace_back(shelf{top_, size.y, 0});
+			top_ += size.y;
 		}
+
+		const point_type pos{best->used, best->y};
+		best->used += size.x;
+		regions_.push_back({pos, size});
+		return pos;
 	}
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] allocator2d* create_allocator(const extent_type extent){
-		body_allocator_type body_allocator(allocator);
-		auto* child = body_allocator_traits::allocate(body_allocator, 1);
-		try{
-			body_allocator_traits::construct(body_allocator, child, allocator, extent);
-		} catch(...){
-			body_allocator_traits::deallocate(body_allocator, child, 1);
-			throw;
+	/**
+	 * @brief Place a batch of rects, tallest first.
+	 *
+	 * @return the position of each rect in input order, nullopt for those that did not fit.
+	 */
+	constexpr position_list_type pack_all(std::span<const extent_type> sizes){
+		using index_list = std::vector<std::size_t, typename std::allocator_traits<Alloc>::template rebind_alloc<std::size_t>>;
+		index_list order(sizes.size(), 0, typename index_list::allocator_type{regions_.get_allocator()});
+		for(std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+		// ties fall back to input order, which keeps the sort stable and usable in constant evaluation
+		std::ranges::sort(order, [&](const std::size_t lhs, const std::size_t rhs){
+			if(sizes[lhs].y != sizes[rhs].y) return sizes[lhs].y > sizes[rhs].y;
+			if(sizes[lhs].x != sizes[rhs].x) return sizes[lhs].x > sizes[rhs].x;
+			return lhs < rhs;
+		});
+
+		position_list_type result(sizes.size(), std::nullopt, typename position_list_type::allocator_type{regions_.get_allocator()});
+		regions_.reserve(regions_.size() + sizes.size());
+		for(const auto index : order){
+			result[index] = pack(sizes[index]);
 		}
-		return child;
+		return result;
+	}
+
+	/**
+	 * @brief Every placed rect, in placement order; pass it to allocator2d::from_layout.
+	 */
+	[[nodiscard]] constexpr const region_list_type& regions() const noexcept{ return regions_; }
+
+	[[nodiscard]] constexpr extent_type extent() const noexcept{ return extent_; }
+
+	/**
+	 * @brief Height actually covered by shelves; the layout fits in {extent().x, used_height()}.
+	 */
+	[[nodiscard]] constexpr size_type used_height() const noexcept{ return top_; }
+
+	constexpr void clear() noexcept{
+		top_ = 0;
+		shelves_.clear();
+		regions_.clear();
 	}
+};
 
-	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE void destroy_allocator(allocator2d* allocator_ptr) noexcept{
-		body_allocator_type body_allocator(allocator);
-		body_allocator_traits::destroy(body_allocator, allocator_ptr);
-		body_allocator_traits::deallocate(body_allocator, allocator_ptr, 1);
+/**
+ * @brief Result of pack_shelves, held in fixed arrays so it can be a constexpr variable.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename T, std::size_t N>
+struct shelf_layout{
+	using extent_type = math::vector2<T>;
+	using point_type = math::vector2<T>;
+	using region = typename allocator2d<std::allocator<std::byte>, T>::region;
+
+	extent_type extent{};
+	/**
+	 * @brief Position of each rect in input order, nullopt for those that did not fit.
+	 */
+	std::array<std::optional<point_type>, N> positions{};
+	std::array<region, N> placed{};
+	std::size_t placed_count{};
+	T used_height{};
+
+	/**
+	 * @brief The placed rects in placement order; pass them to allocator2d::from_layout.
+	 */
+	[[nodiscard]] constexpr std::span<const region> regions() const noexcept{
+		return {placed.data(), placed_count};
 	}
 };
 
-template <typename Alloc>
-void allocator2d<Alloc>::body_pool_deleter::operator()(body_pool* pool) const noexcept{
-	if(pool == nullptr) return;
-	body_pool_allocator_type allocator(pool->allocator);
-	body_pool_allocator_traits::destroy(allocator, pool);
-	body_pool_allocator_traits::deallocate(allocator, pool, 1);
+/**
+ * @brief shelf_packer::pack_all over a fixed list of rects, for atlases known at build time.
+ *
+ * Runs in constant evaluation, e.g. `constexpr auto layout = pack_shelves({512, 512}, {{64, 32}, {16, 16}});`,
+ * and places exactly like shelf_packer. allocator2d::from_layout(layout.extent, layout.regions()) then
+ * adopts the baked layout at runtime without packing.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename T = std::uint32_t, std::size_t N>
+[[nodiscard]] constexpr shelf_layout<T, N> pack_shelves(const math::vector2<T> extent, const math::vector2<T> (&sizes)[N]){
+	shelf_packer<std::allocator<std::byte>, T> packer{extent};
+	const auto positions = packer.pack_all(sizes);
+
+	shelf_layout<T, N> layout{.extent = extent, .used_height = packer.used_height()};
+	for(std::size_t i = 0; i < N; ++i){
+		layout.positions[i] = positions[i];
+	}
+	for(const auto& region : packer.regions()){
+		layout.placed[layout.placed_count++] = region;
+	}
+	return layout;
 }
 
-template <typename Alloc>
-typename allocator2d<Alloc>::body_pool& allocator2d<Alloc>::ensure_body_pool_(){
-	if(!body_pool_owner_){
-		body_pool_allocator_type pool_allocator(allocator_);
-		auto* pool = body_pool_allocator_traits::allocate(pool_allocator, 1);
-		try{
-			body_pool_allocator_traits::construct(pool_allocator, pool, allocator_);
-		} catch(...){
-			body_pool_allocator_traits::deallocate(pool_allocator, pool, 1);
-			throw;
+/**
+ * @brief Allocates across the layers of a texture array, with one allocator2d per layer.
+ *
+ * Every layer keeps a fit summary (free area and max_free_extent) in one contiguous list, so layers that
+ * cannot hold a request are skipped without touching their trees. Under layer_policy::balanced the layer
+ * with the most free area is tried first, which keeps the layers evenly filled; layer_policy::first_fit
+ * tries them in index order and packs the low layers densely instead.
+ */
+MO_YANXI_ALLOCATOR_2D_EXPORT
+template <typename Alloc = std::allocator<std::byte>, typename T = std::uint32_t>
+struct layered_allocator2d{
+	using layer_type = allocator2d<Alloc, T>;
+	using size_type = typename layer_type::size_type;
+	using large_size_type = typename layer_type::large_size_type;
+	using extent_type = typename layer_type::extent_type;
+	using point_type = typename layer_type::point_type;
+	using region = typename layer_type::region;
+	using allocator_type = Alloc;
+
+	enum struct layer_policy{
+		balanced,
+		first_fit,
+	};
+
+	struct layered_allocation{
+		size_type layer{};
+		point_type point{};
+		/**
+		 * @brief Extent actually taken, which allocate_mip rounds up to its alignment.
+		 */
+		extent_type extent{};
+
+		constexpr bool operator==(const layered_allocation& other) const noexcept = default;
+	};
+
+private:
+	struct layer_summary{
+		large_size_type remain{};
+		extent_type max_free{};
+
+		[[nodiscard]] constexpr bool may_fit(const extent_type extent) const noexcept{
+			return area_of(extent) <= remain && !extent.beyond(max_free);
 		}
-		body_pool_owner_.reset(pool);
+	};
+
+	template <typename V>
+	using list_type = std::vector<V, typename std::allocator_traits<Alloc>::template rebind_alloc<V>>;
+
+	list_type<layer_type> layers_{};
+	list_type<layer_summary> summaries_{};
+	list_type<size_type> order_{};
+	extent_type extent_{};
+	large_size_type fragment_threshold_{};
+	layer_policy policy_{};
+
+	void refresh_(const size_type layer) noexcept{
+		summaries_[layer] = {layers_[layer].remain_area(), layers_[layer].max_free_extent()};
 	}
-	return *body_pool_owner_;
-}
 
-template <typename Alloc>
-allocator2d<Alloc>& allocator2d<Alloc>::body_allocator_at_(const body_slot_type slot){
-	auto& pool = ensure_body_pool_();
-	assert(slot < pool.allocators.size());
-	auto& entry = pool.allocators[slot];
-	assert(entry != nullptr);
-	return *entry;
-}
+	/**
+	 * @brief Fill order_ with the layers whose summary may hold @p extent, in the order the policy tries them.
+	 */
+	void order_candidates_(const extent_type extent){
+		order_.clear();
+		for(size_type i = 0; i < summaries_.size(); ++i){
+			if(summaries_[i].may_fit(extent)) order_.push_back(i);
+		}
+		if(policy_ == layer_policy::balanced){
+			std::ranges::sort(order_, [this](const size_type lhs, const size_type rhs){
+				if(summaries_[lhs].remain != summaries_[rhs].remain) return summaries_[lhs].remain > summaries_[rhs].remain;
+				return lhs < rhs;
+			});
+		}
+	}
 
-template <typename Alloc>
-const allocator2d<Alloc>& allocator2d<Alloc>::body_allocator_at_(const body_slot_type slot) const{
-	assert(body_pool_owner_ != nullptr);
-	const auto& pool = *body_pool_owner_;
-	assert(slot < pool.allocators.size());
-	const auto& entry = pool.allocators[slot];
-	assert(entry != nullptr);
-	return *entry;
-}
+	/**
+	 * @brief Allocate in the first candidate layer where @p fn, given the layer, succeeds.
+	 */
+	template <typename Fn>
+	std::optional<layered_allocation> allocate_in_layers_(const extent_type extent, Fn fn){
+		for(const auto layer : order_){
+			if(const auto point = fn(layers_[layer])){
+				refresh_(layer);
+				return layered_allocation{layer, *point, extent};
+			}
+		}
+		return std::nullopt;
+	}
 
-template <typename Alloc>
-typename allocator2d<Alloc>::body_slot_type allocator2d<Alloc>::acquire_body_slot_(){
-	auto& pool = ensure_body_pool_();
-	if(!pool.free_slots.empty()){
-		const auto slot = pool.free_slots.back();
-		pool.free_slots.pop_back();
-		assert(slot < pool.allocators.size());
-		assert(pool.allocators[slot] == nullptr);
-		return slot;
-	}
-
-	const auto slot = static_cast<body_slot_type>(pool.allocators.size());
-	assert(slot != invalid_body_slot);
-	pool.allocators.push_back(nullptr);
-	return slot;
-}
+	[[nodiscard]] static constexpr size_type round_up_(const size_type value, const size_type alignment) noexcept{
+		return static_cast<size_type>((value + alignment - 1) / alignment * alignment);
+	}
 
-template <typename Alloc>
-void allocator2d<Alloc>::release_body_slot_(const body_slot_type slot) noexcept{
-	assert(body_pool_owner_ != nullptr);
-	auto& pool = *body_pool_owner_;
-	assert(slot < pool.allocators.size());
-	assert(pool.allocators[slot] == nullptr);
-	pool.free_slots.push_back(slot);
-}
+public:
+	[[nodiscard]] layered_allocator2d() = default;
+
+	[[nodiscard]] layered_allocator2d(
+		const extent_type extent, const size_type layer_count,
+		const layer_policy policy = layer_policy::balanced, const large_size_type frag_thres = 0,
+		const allocator_type& allocator = {})
+		: layers_(allocator), summaries_(allocator), order_(allocator),
+		  extent_(extent), fragment_threshold_(frag_thres), policy_(policy){
+		layers_.reserve(layer_count);
+		summaries_.reserve(layer_count);
+		order_.reserve(layer_count);
+		for(size_type i = 0; i < layer_count; ++i) add_layer();
+	}
 
-template <typename Alloc>
-allocator2d<Alloc>& allocator2d<Alloc>::create_body_allocator_(split_point& node){
-	assert(node.body_slot == invalid_body_slot);
-	const auto slot = acquire_body_slot_();
-	auto& pool = *body_pool_owner_;
-	auto& entry = pool.allocators[slot];
-	assert(entry == nullptr);
-	try{
-		entry = pool.create_allocator(node.body_extent());
-	} catch(...){
-		release_body_slot_(slot);
-		throw;
-	}
-	auto& child = *entry;
-	node.body_slot = slot;
-	register_body_node_(&node);
-	return child;
-}
+	/**
+	 * @brief Append an empty layer, e.g. after the backing array gained one.
+	 *
+	 * @return index of the new layer.
+	 */
+	size_type add_layer(){
+		layers_.emplace_back(allocator_type{layers_.get_allocator()}, extent_, fragment_threshold_);
+		summaries_.push_back({});
+		order_.reserve(layers_.size());
+		const auto layer = static_cast<size_type>(layers_.size() - 1);
+		refresh_(layer);
+		return layer;
+	}
 
-template <typename Alloc>
-void allocator2d<Alloc>::destroy_body_allocator_(split_point& node) noexcept{
-	assert(node.body_slot != invalid_body_slot);
-	assert(body_pool_owner_ != nullptr);
-	const auto slot = node.body_slot;
-	auto& pool = *body_pool_owner_;
-	assert(slot < pool.allocators.size());
-	auto& entry = pool.allocators[slot];
-	assert(entry != nullptr);
-	unregister_body_node_(&node);
-	pool.destroy_allocator(entry);
-	entry = nullptr;
-	release_body_slot_(slot);
-	node.body_slot = invalid_body_slot;
-}
+	[[nodiscard]] std::optional<layered_allocation> allocate(const extent_type extent){
+		order_candidates_(extent);
+		return allocate_in_layers_(extent, [&](layer_type& layer){ return layer.allocate(extent); });
+	}
+
+	/**
+	 * @brief Allocate @p extent at a position shared by the first @p levels mip levels.
+	 *
+	 * The point and the extent are rounded to multiples of 2^(levels - 1), so on every mip level k below
+	 * @p levels the allocation is exactly {point >> k, extent >> k}, and each of those texels is filtered
+	 * from this allocation alone. Allocations from allocate may share a layer with it; they get no such
+	 * guarantee for themselves, as their own texels can straddle a neighbour's on coarser levels. The point
+	 * comes from allocator2d::find_aligned on each candidate layer and is taken with allocator2d::reserve;
+	 * deallocate releases it as usual.
+	 */
+	[[nodiscard]] std::optional<layered_allocation> allocate_mip(const extent_type extent, const unsigned levels){
+		if(levels == 0 || levels > std::numeric_limits<size_type>::digits) return std::nullopt;
+		const size_type alignment = size_type{1} << (levels - 1);
+		constexpr auto max_size = std::numeric_limits<size_type>::max();
+		if(extent.x > max_size - (alignment - 1) || extent.y > max_size - (alignment - 1)) return std::nullopt;
+
+		const extent_type rounded{round_up_(extent.x, alignment), round_up_(extent.y, alignment)};
+		order_candidates_(rounded);
+		return allocate_in_layers_(rounded, [&](layer_type& layer) -> std::optional<point_type>{
+			const auto point = layer.find_aligned(rounded, alignment);
+			if(point && layer.reserve(*point, rounded)) return point;
+			return std::nullopt;
+		});
+	}
+
+	bool deallocate(const size_type layer, const point_type point){
+		if(layer >= layers_.size() || !layers_[layer].deallocate(point)) return false;
+		refresh_(layer);
+		return true;
+	}
+
+	bool deallocate(const layered_allocation& allocation){
+		return deallocate(allocation.layer, allocation.point);
+	}
+
+	[[nodiscard]] const layer_type& layer(const size_type index) const noexcept{
+		return layers_[index];
+	}
+
+	[[nodiscard]] size_type layer_count() const noexcept{
+		return static_cast<size_type>(layers_.size());
+	}
+
+	[[nodiscard]] extent_type extent() const noexcept{ return extent_; }
+
+	[[nodiscard]] large_size_type remain_area() const noexcept{
+		large_size_type area{};
+		for(const auto& summary : summaries_) area += summary.remain;
+		return area;
+	}
+};
 
+/**
+ * @brief Buddy allocator over a power-of-two square, for atlases whose requests are power-of-two squares.
+ *
+ * Level l cuts the square into 4^l blocks of side extent >> l, numbered in Morton order, so the four
+ * children of block i are 4i to 4i + 3 and share one nibble of a bitmap word. Every level keeps a bitmap
+ * of its free blocks, stacked with one bit per non-empty word until a single word is left, and a bitmap of
+ * the blocks split into children. Allocate takes the lowest free block of the deepest level with room and
+ * splits it down; deallocate walks the split bits down to the block and merges four free buddies back
+ * into their parent right away. Both touch O(levels) words.
+ *
+ * A request takes the smallest block holding it, so anything but a power-of-two square wastes the rest
+ * of its block.
+ */
 MO_YANXI_ALLOCATOR_2D_EXPORT
 template <typename Alloc = std::allocator<std::byte>>
-struct allocator2d_checked : allocator2d<Alloc>{
-	[[nodiscard]] allocator2d_checked(const typename allocator2d<Alloc>::allocator_type& allocator,
-	                                  typename allocator2d<Alloc>::large_size_type frag_thres = 0)
-		: allocator2d<Alloc>(allocator, frag_thres){
+struct buddy_allocator2d{
+	using size_type = typename allocator2d<Alloc>::size_type;
+	using large_size_type = typename allocator2d<Alloc>::large_size_type;
+	using extent_type = typename allocator2d<Alloc>::extent_type;
+	using point_type = typename allocator2d<Alloc>::point_type;
+	using allocator_type = Alloc;
+
+	static constexpr std::size_t max_levels = 16;
+
+private:
+	using word_type = std::uint64_t;
+	static constexpr std::size_t word_bits = 64;
+	static constexpr std::size_t invalid_block = std::numeric_limits<std::size_t>::max();
+	// 4^15 blocks on the deepest level need four summary layers above the block bits
+	static constexpr std::size_t max_layers = 5;
+
+	using word_list = std::vector<word_type, typename std::allocator_traits<Alloc>::template rebind_alloc<word_type>>;
+
+	struct level_bits{
+		/**
+		 * @brief Start of every free bitmap layer in free_words_, the block bits first.
+		 */
+		std::array<std::size_t, max_layers> free_layers{};
+		std::size_t layer_count{};
+		std::size_t split_offset{};
+	};
+
+	size_type side_{};
+	size_type min_side_{};
+	std::size_t level_count_{};
+	large_size_type remain_area_{};
+	std::array<level_bits, max_levels> levels_{};
+	word_list free_words_{};
+	word_list split_words_{};
+
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] static std::size_t word_count_(const std::size_t bits) noexcept{
+		return (bits + word_bits - 1) / word_bits;
 	}
 
-	[[nodiscard]] allocator2d_checked(const typename allocator2d<Alloc>::extent_type& extent,
-	                                  typename allocator2d<Alloc>::large_size_type frag_thres = 0)
-		: allocator2d<Alloc>(extent, frag_thres){
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] static word_type bit_(const std::size_t index) noexcept{
+		return word_type{1} << (index % word_bits);
 	}
 
-	[[nodiscard]] allocator2d_checked(const typename allocator2d<Alloc>::allocator_type& allocator,
-	                                  const typename allocator2d<Alloc>::extent_type& extent,
-	                                  typename allocator2d<Alloc>::large_size_type frag_thres = 0)
-		: allocator2d<Alloc>(allocator, extent, frag_thres){
+	[[nodiscard]] static std::uint64_t spread_bits_(std::uint64_t v) noexcept{
+		v &= 0xffff'ffffu;
+		v = (v | v << 16) & 0x0000'ffff'0000'ffffu;
+		v = (v | v << 8) & 0x00ff'00ff'00ff'00ffu;
+		v = (v | v << 4) & 0x0f0f'0f0f'0f0f'0f0fu;
+		v = (v | v << 2) & 0x3333'3333'3333'3333u;
+		v = (v | v << 1) & 0x5555'5555'5555'5555u;
+		return v;
 	}
 
-	[[nodiscard]] allocator2d_checked() = default;
+	[[nodiscard]] static std::uint64_t gather_bits_(std::uint64_t v) noexcept{
+		v &= 0x5555'5555'5555'5555u;
+		v = (v | v >> 1) & 0x3333'3333'3333'3333u;
+		v = (v | v >> 2) & 0x0f0f'0f0f'0f0f'0f0fu;
+		v = (v | v >> 4) & 0x00ff'00ff'00ff'00ffu;
+		v = (v | v >> 8) & 0x0000'ffff'0000'ffffu;
+		v = (v | v >> 16) & 0x0000'0000'ffff'ffffu;
+		return v;
+	}
 
-	~allocator2d_checked(){
-		this->check_leak_();
+	MO_YANXI_ALLOCATOR_2D_FORCE_INLINE [[nodiscard]] size_type block_side_at_(const std::size_t level) const noexcept{
+		return side_ >> level;
 	}
 
-	allocator2d_checked(allocator2d_checked&& other) noexcept(std::is_nothrow_move_constructible_v<allocator2d<Alloc>>) = default;
+	[[nodiscard]] std::size_t block_at_(const std::size_t level, const point_type point) const noexcept{
+		const auto shift = std::countr_zero(block_side_at_(level));
+		return static_cast<std::size_t>(spread_bits_(point.x >> shift) | spread_bits_(point.y >> shift) << 1);
+	}
 
-	allocator2d_checked& operator=(allocator2d_checked&& other) noexcept(std::is_nothrow_move_assignable_v<allocator2d<Alloc>>){
-		if(this == &other) return *this;
-		this->check_leak_();
-		allocator2d<Alloc>::operator=(std::move(other));
-		return *this;
+	[[nodiscard]] point_type point_of_(const std::size_t level, const std::size_t block) const noexcept{
+		const auto side = block_side_at_(level);
+		return {static_cast<size_type>(gather_bits_(block)) * side, static_cast<size_type>(gather_bits_(block >> 1)) * side};
 	}
 
-protected:
-	allocator2d_checked& operator=(const allocator2d_checked& other) = default;
-	allocator2d_checked(const allocator2d_checked& other) = default;
+	[[nodiscard]] bool is_free_(const std::size_t level, const std::size_t block) const noexcept{
+		return free_words_[levels_[level].free_layers[0] + block / word_bits] & bit_(block);
+	}
+
+	[[nodiscard]] bool is_split_(const std::size_t level, const std::size_t block) const noexcept{
+		// the deepest level never splits and has no split bits
+		return level + 1 < level_count_ && split_words_[levels_[level].split_offset + block / word_bits] & bit_(block);
+	}
+
+	void set_split_(const std::size_t level, const std::size_t block, const bool split) noexcept{
+		auto& word = split_words_[levels_[level].split_offset + block / word_bits];
+		word = split ? word | bit_(block) : word & ~bit_(block);
+	}
+
+	void mark_free_(const std::size_t level, std::size_t block) noexcept{
+		const auto& bits = levels_[level];
+		for(std::size_t layer = 0; layer < bits.layer_count; ++layer, block /= word_bits){
+			auto& word = free_words_[bits.free_layers[layer] + block / word_bits];
+			const bool was_empty = word == 0;
+			word |= bit_(block);
+			if(!was_empty) break;
+		}
+	}
+
+	/**
+	 * @brief Clear the free bits @p mask of the word holding @p block.
+	 */
+	void mark_used_(const std::size_t level, std::size_t block, word_type mask) noexcept{
+		const auto& bits = levels_[level];
+		for(std::size_t layer = 0; layer < bits.layer_count; ++layer, block /= word_bits){
+			auto& word = free_words_[bits.free_layers[layer] + block / word_bits];
+			word &= ~mask;
+			if(word != 0) break;
+			mask = bit_(block / word_bits);
+		}
+	}
+
+	/**
+	 * @brief Lowest free block of @p level, following the summary layers down from the top word.
+	 */
+	[[nodiscard]] std::size_t find_free_(const std::size_t level) const noexcept{
+		const auto& bits = levels_[level];
+		std::size_t block = 0;
+		for(auto layer = bits.layer_count; layer-- > 0;){
+			const auto word = free_words_[bits.free_layers[layer] + block];
+			if(word == 0) return invalid_block;
+			block = block * word_bits + std::countr_zero(word);
+		}
+		return block;
+	}
+
+public:
+	[[nodiscard]] buddy_allocator2d() = default;
+
+	/**
+	 * @param side edge of the square, a power of two.
+	 * @param min_side edge of the smallest block, a power of two; the bitmaps take about (side / min_side)^2 / 5 bytes.
+	 * @throw std::invalid_argument if @p side or @p min_side is not a power of two, or @p min_side exceeds @p side.
+	 * @throw std::length_error if @p side / @p min_side needs more than max_levels levels, e.g. 65536 with the
+	 * default @p min_side.
+	 */
+	[[nodiscard]] explicit buddy_allocator2d(const size_type side, const size_type min_side = 1, const allocator_type& allocator = {})
+		: side_(side), min_side_(min_side), free_words_(allocator), split_words_(allocator){
+		if(!std::has_single_bit(side) || !std::has_single_bit(min_side) || min_side > side){
+			throw std::invalid_argument{"buddy_allocator2d: side and min_side must be powers of two with min_side <= side"};
+		}
+		level_count_ = static_cast<std::size_t>(std::countr_zero(side) - std::countr_zero(min_side)) + 1;
+		if(level_count_ > max_levels){
+			throw std::length_error{"buddy_allocator2d: side / min_side needs more than max_levels levels"};
+		}
+
+		std::size_t free_size{};
+		std::size_t split_size{};
+		for(std::size_t level = 0; level < level_count_; ++level){
+			auto& bits = levels_[level];
+			for(auto count = std::size_t{1} << (2 * level); ; count = word_count_(count)){
+				assert(bits.layer_count < max_layers);
+				bits.free_layers[bits.layer_count++] = free_size;
+				free_size += word_count_(count);
+				if(count <= word_bits) break;
+			}
+			if(level + 1 < level_count_){
+				bits.split_offset = split_size;
+				split_size += word_count_(std::size_t{1} << (2 * level));
+			}
+		}
+		free_words_.resize(free_size);
+		split_words_.resize(split_size);
+
+		mark_free_(0, 0);
+		remain_area_ = area_of(extent());
+	}
+
+	/**
+	 * @brief Edge of the block a request of @p extent takes.
+	 */
+	[[nodiscard]] size_type block_side(const extent_type extent) const noexcept{
+		return std::max(std::bit_ceil(std::max(extent.x, extent.y)), min_side_);
+	}
+
+	[[nodiscard]] std::optional<point_type> allocate(const extent_type extent){
+		if(extent.x == 0 || extent.y == 0 || extent.beyond(this->extent())) return std::nullopt;
+
+		const auto side = block_side(extent);
+		const auto target = static_cast<std::size_t>(std::countr_zero(side_) - std::countr_zero(side));
+
+		auto level = target;
+		auto block = find_free_(level);
+		while(block == invalid_block){
+			if(level == 0) return std::nullopt;
+			block = find_free_(--level);
+		}
+
+		mark_used_(level, block, bit_(block));
+		for(; level < target; ++level){
+			set_split_(level, block, true);
+			block *= 4;
+			for(std::size_t buddy = 1; buddy < 4; ++buddy) mark_free_(level + 1, block + buddy);
+		}
+
+		remain_area_ -= static_cast<large_size_type>(side) * side;
+		return point_of_(target, block);
+	}
+
+	/**
+	 * @return false if @p point is not the point of a live allocation.
+	 */
+	bool deallocate(const point_type point) noexcept{
+		if(point.x >= side_ || point.y >= side_) return false;
+
+		std::size_t level = 0;
+		std::size_t block = 0;
+		for(;; ++level){
+			block = block_at_(level, point);
+			if(is_free_(level, block)) return false;
+			if(!is_split_(level, block)) break;
+		}
+		if(point_of_(level, block) != point) return false;
+
+		const auto side = block_side_at_(level);
+		remain_area_ += static_cast<large_size_type>(side) * side;
+
+		mark_free_(level, block);
+		for(; level > 0; --level){
+			const auto first = block & ~std::size_t{3};
+			const auto nibble = word_type{0xf} << (first % word_bits);
+			if((free_words_[levels_[level].free_layers[0] + first / word_bits] & nibble) != nibble) break;
+
+			mark_used_(level, first, nibble);
+			block >>= 2;
+			set_split_(level - 1, block, false);
+			mark_free_(level - 1, block);
+		}
+		return true;
+	}
+
+	[[nodiscard]] extent_type extent() const noexcept{ return {side_, side_}; }
+
+	[[nodiscard]] size_type min_block_side() const noexcept{ return min_side_; }
+
+	[[nodiscard]] large_size_type remain_area() const noexcept{ return remain_area_; }
+
+	/**
+	 * @brief Check the bitmaps against each other; O(n) in the number of blocks, meant for tests and debugging.
+	 *
+	 * Verifies that every block below the root has a split parent exactly when it is free, split or used,
+	 * that four free buddies were merged, that the summary layers match the block bits, and that the free
+	 * blocks add up to remain_area.
+	 */
+	[[nodiscard]] bool validate() const noexcept{
+		if(level_count_ == 0) return remain_area_ == 0;
+
+		large_size_type free_area{};
+		for(std::size_t level = 0; level < level_count_; ++level){
+			const auto& bits = levels_[level];
+			const auto count = std::size_t{1} << (2 * level);
+			const auto side = static_cast<large_size_type>(block_side_at_(level));
+			for(std::size_t block = 0; block < count; ++block){
+				const bool free = is_free_(level, block);
+				const bool split = is_split_(level, block);
+				const bool reachable = level == 0 || is_split_(level - 1, block / 4);
+				if(free && split) return false;
+				if(!reachable && (free || split)) return false;
+				if(free) free_area += side * side;
+			}
+			if(level > 0){
+				for(std::size_t first = 0; first < count; first += 4){
+					if(is_free_(level, first) && is_free_(level, first + 1) && is_free_(level, first + 2) && is_free_(level, first + 3)){
+						return false;
+					}
+				}
+			}
+
+			auto below = word_count_(count);
+			for(std::size_t layer = 1; layer < bits.layer_count; ++layer, below = word_count_(below)){
+				for(std::size_t word = 0; word < below; ++word){
+					const bool nonempty = free_words_[bits.free_layers[layer - 1] + word] != 0;
+					const bool summarised = free_words_[bits.free_layers[layer] + word / word_bits] & bit_(word);
+					if(nonempty != summarised) return false;
+				}
+			}
+		}
+		return free_area == remain_area_;
+	}
 };
 }
 #undef MO_YANXI_ALLOCATOR_2D_EXPORT
@@ -984,3 +4398,5 @@ protected:
 #undef MO_YANXI_ALLOCATOR_2D_CALL_CONST
 #undef MO_YANXI_ALLOCATOR_2D_FORCE_INLINE
 #undef MO_YANXI_ALLOCATOR_2D_NO_UNIQUE_ADDRESS
+#undef MO_YANXI_ALLOCATOR_2D_HAS_SSE2
+#undef MO_YANXI_ALLOCATOR_2D_HAS_AVX2
@@ -3,6 +3,14 @@ module;
 #include <cassert>
 #include <version>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
 export module mo_yanxi.allocator2d;
 
 #define MO_YANXI_ALLOCATOR_2D_ENABLE_MODULE
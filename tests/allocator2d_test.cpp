@@ -1,8 +1,15 @@
 #include <gtest/gtest.h>
 
 #include <algorithm>
+#include <coroutine>
 #include <cstdint>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <random>
+#include <stdexcept>
 #include <utility>
 #include <vector>
 
@@ -141,3 +148,1428 @@ TEST(Allocator2D, MovePreservesNestedAllocatorLinks) {
     ASSERT_TRUE(full.has_value());
     EXPECT_EQ(*full, (usize2{0, 0}));
 }
+
+TEST(Allocator2D, ReusesBodyOfReusedBodyAndMergesBack) {
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+
+    auto a = alloc.allocate({32, 32});
+    auto b = alloc.allocate({32, 64});
+    auto c = alloc.allocate({32, 32});
+    ASSERT_TRUE(a.has_value());
+    ASSERT_TRUE(b.has_value());
+    ASSERT_TRUE(c.has_value());
+
+    EXPECT_TRUE(alloc.deallocate(*a));
+
+    std::vector<usize2> quarters;
+    for (int i = 0; i < 4; ++i) {
+        auto q = alloc.allocate({16, 16});
+        ASSERT_TRUE(q.has_value());
+        quarters.push_back(*q);
+    }
+    EXPECT_EQ(quarters.front(), (usize2{0, 0}));
+
+    EXPECT_TRUE(alloc.deallocate(quarters.front()));
+
+    auto inner = alloc.allocate({8, 8});
+    ASSERT_TRUE(inner.has_value());
+    EXPECT_EQ(*inner, (usize2{0, 0}));
+    auto inner_rest = alloc.allocate({8, 16});
+    ASSERT_TRUE(inner_rest.has_value());
+    EXPECT_EQ(*inner_rest, (usize2{8, 0}));
+
+    EXPECT_TRUE(alloc.deallocate(*inner));
+    EXPECT_TRUE(alloc.deallocate(*inner_rest));
+
+    auto refill = alloc.allocate({16, 16});
+    ASSERT_TRUE(refill.has_value());
+    EXPECT_EQ(*refill, (usize2{0, 0}));
+    quarters.front() = *refill;
+
+    for (const auto& q : quarters) {
+        EXPECT_TRUE(alloc.deallocate(q));
+    }
+    EXPECT_TRUE(alloc.deallocate(*b));
+    EXPECT_TRUE(alloc.deallocate(*c));
+    EXPECT_EQ(alloc.remain_area(), alloc.extent().area());
+
+    auto full = alloc.allocate({64, 64});
+    ASSERT_TRUE(full.has_value());
+    EXPECT_EQ(*full, (usize2{0, 0}));
+}
+
+TEST(Allocator2D, MemoryUsageTracksBookkeeping) {
+    mo_yanxi::allocator2d<> alloc{{512, 512}};
+    const auto initial = alloc.memory_usage();
+    EXPECT_GT(initial.total(), 0u);
+
+    std::vector<usize2> positions;
+    for (std::uint32_t i = 0; i < 64; ++i) {
+        auto pos = alloc.allocate({8 + i % 5, 8 + i % 7});
+        ASSERT_TRUE(pos.has_value());
+        positions.push_back(*pos);
+    }
+
+    const auto filled = alloc.memory_usage();
+    EXPECT_GT(filled.nodes, initial.nodes);
+    EXPECT_GT(filled.node_map, initial.node_map);
+    EXPECT_EQ(filled.total(), filled.nodes + filled.node_map + filled.region_indexes);
+
+    for (const auto& pos : positions) {
+        EXPECT_TRUE(alloc.deallocate(pos));
+    }
+    EXPECT_GE(alloc.memory_usage().region_indexes, initial.region_indexes);
+
+    // the fragment buckets keep their capacity, so repeating the same cycle settles instead of growing
+    const auto cycle = [&] {
+        for (std::uint32_t i = 0; i < 64; ++i) {
+            EXPECT_TRUE(alloc.allocate({8 + i % 5, 8 + i % 7}));
+        }
+        for (const auto& pos : positions) {
+            EXPECT_TRUE(alloc.deallocate(pos));
+        }
+        return alloc.memory_usage().region_indexes;
+    };
+    auto settled = cycle();
+    for (int i = 0; i < 8; ++i) {
+        settled = cycle();
+    }
+    EXPECT_EQ(cycle(), settled);
+}
+
+TEST(FlatPointMap, MatchesReferenceUnderChurn) {
+    mo_yanxi::flat_point_map<usize2, std::uint32_t, std::allocator<std::byte>> table;
+    std::map<std::pair<std::uint32_t, std::uint32_t>, std::uint32_t> reference;
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<std::uint32_t> coord(0, 63);
+
+    for (std::uint32_t i = 0; i < 20000; ++i) {
+        const usize2 point{coord(rng), coord(rng)};
+        const auto key = std::pair{point.x, point.y};
+        if (rng() % 3 == 0) {
+            EXPECT_EQ(table.erase(point), reference.erase(key) == 1);
+        } else {
+            table.insert_or_assign(point, i);
+            reference[key] = i;
+        }
+    }
+
+    EXPECT_EQ(table.size(), reference.size());
+    for (std::uint32_t x = 0; x < 64; ++x) {
+        for (std::uint32_t y = 0; y < 64; ++y) {
+            const auto* found = table.find({x, y});
+            const auto itr = reference.find({x, y});
+            ASSERT_EQ(found != nullptr, itr != reference.end());
+            if (found) {
+                EXPECT_EQ(*found, itr->second);
+            }
+        }
+    }
+}
+
+TEST(FlatPointMap, DropsTombstonesWithoutGrowing) {
+    mo_yanxi::flat_point_map<usize2, std::uint32_t, std::allocator<std::byte>> table;
+    table.reserve(256);
+    const auto capacity = table.capacity();
+    std::map<std::pair<std::uint32_t, std::uint32_t>, std::uint32_t> reference;
+    std::mt19937 rng(13);
+
+    // a sliding window of keys leaves tombstones behind on every step
+    for (std::uint32_t i = 0; i < 50000; ++i) {
+        const usize2 point{i % 4096, i / 4096};
+        table.insert_or_assign(point, i);
+        reference[{point.x, point.y}] = i;
+        if (i >= 100) {
+            const usize2 stale{(i - 100) % 4096, (i - 100) / 4096};
+            EXPECT_TRUE(table.erase(stale));
+            reference.erase({stale.x, stale.y});
+        }
+    }
+
+    EXPECT_EQ(table.capacity(), capacity);
+    ASSERT_EQ(table.size(), reference.size());
+    for (const auto& [key, value] : reference) {
+        const auto* found = table.find({key.first, key.second});
+        ASSERT_NE(found, nullptr);
+        EXPECT_EQ(*found, value);
+    }
+}
+
+namespace {
+
+std::size_t counted_allocations{};
+
+template <typename T>
+struct counting_allocator {
+    using value_type = T;
+
+    counting_allocator() = default;
+
+    template <typename U>
+    counting_allocator(const counting_allocator<U>&) noexcept {}
+
+    T* allocate(const std::size_t count) {
+        ++counted_allocations;
+        return std::allocator<T>{}.allocate(count);
+    }
+
+    void deallocate(T* ptr, const std::size_t count) noexcept {
+        std::allocator<T>{}.deallocate(ptr, count);
+    }
+
+    template <typename U>
+    bool operator==(const counting_allocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+}
+
+TEST(Allocator2D, ReservedCapacityMakesChurnAllocationFree) {
+    enum struct engine { fragments, large_regions, subtree };
+    for (const auto mode : {engine::fragments, engine::large_regions, engine::subtree}) {
+        // a threshold of 1 keeps every region of this mix, all multiples of 4, out of the fragment index
+        mo_yanxi::allocator2d<counting_allocator<std::byte>> alloc{{256, 256}, mode == engine::large_regions ? 1u : 0u};
+        alloc.use_subtree_search(mode == engine::subtree);
+        alloc.reserve_capacity(256, 2048);
+
+        std::vector<usize2> live;
+        live.reserve(256);
+        // every cycle churns the same mix and ends empty, so the tree comes back to the same state
+        const auto cycle = [&] {
+            std::mt19937 rng(17);
+            for (int i = 0; i < 20000; ++i) {
+                if (live.size() < 128 && rng() % 2) {
+                    const usize2 extent{4u << rng() % 3, 4u << rng() % 3};
+                    if (const auto pos = alloc.allocate(extent)) live.push_back(*pos);
+                } else if (!live.empty()) {
+                    const auto index = rng() % live.size();
+                    EXPECT_TRUE(alloc.deallocate(live[index]));
+                    live[index] = live.back();
+                    live.pop_back();
+                }
+            }
+            for (const auto& pos : live) {
+                EXPECT_TRUE(alloc.deallocate(pos));
+            }
+            live.clear();
+        };
+
+        // the subtree search promises a free first cycle; the large-region tree gets there too, as its spare
+        // nodes are sized up front. Fragment groups are created and grown on demand, and emptied ones are
+        // handed to other extents, so the default engine only promises to stop allocating after a warm-up
+        int warm_up = 0;
+        do {
+            counted_allocations = 0;
+            cycle();
+        } while (mode == engine::fragments && counted_allocations != 0 && ++warm_up < 8);
+        ASSERT_LT(warm_up, 8);
+        if (mode != engine::fragments) {
+            EXPECT_EQ(counted_allocations, 0u) << "first cycle, engine " << static_cast<int>(mode);
+        }
+
+        counted_allocations = 0;
+        for (int i = 0; i < 4; ++i) {
+            cycle();
+        }
+        EXPECT_EQ(counted_allocations, 0u) << "engine " << static_cast<int>(mode);
+        EXPECT_TRUE(alloc.validate());
+    }
+}
+
+TEST(Allocator2D, HandleDeallocateMatchesPointDeallocate) {
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+
+    auto a = alloc.allocate_handle({32, 32});
+    auto b = alloc.allocate_handle({32, 64});
+    auto c = alloc.allocate({32, 32});
+    ASSERT_TRUE(a.has_value());
+    ASSERT_TRUE(b.has_value());
+    ASSERT_TRUE(c.has_value());
+    EXPECT_EQ(a->point, (usize2{0, 0}));
+    EXPECT_EQ(b->point, (usize2{32, 0}));
+
+    EXPECT_TRUE(alloc.deallocate(*a));
+    EXPECT_FALSE(alloc.deallocate(*a));
+
+    // the freed body is reused while its children are busy, so the stale handle must stay rejected
+    auto d = alloc.allocate_handle({16, 16});
+    ASSERT_TRUE(d.has_value());
+    EXPECT_EQ(d->point, (usize2{0, 0}));
+    EXPECT_NE(d->node, a->node);
+    EXPECT_FALSE(alloc.deallocate(*a));
+
+    EXPECT_TRUE(alloc.deallocate(d->point));
+    EXPECT_FALSE(alloc.deallocate(*d));
+    EXPECT_TRUE(alloc.deallocate(*b));
+    EXPECT_TRUE(alloc.deallocate(*c));
+    EXPECT_EQ(alloc.remain_area(), alloc.extent().area());
+}
+
+TEST(Allocator2D, GrowKeepsAllocationsInPlace) {
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+
+    auto a = alloc.allocate({64, 32});
+    auto b = alloc.allocate({32, 32});
+    ASSERT_TRUE(a.has_value());
+    ASSERT_TRUE(b.has_value());
+    EXPECT_FALSE(alloc.allocate({64, 64}).has_value());
+
+    EXPECT_FALSE(alloc.grow({32, 128}));
+    ASSERT_TRUE(alloc.grow({128, 128}));
+    EXPECT_EQ(alloc.extent(), (usize2{128, 128}));
+    EXPECT_EQ(alloc.remain_area(), 128u * 128u - 64u * 32u - 32u * 32u);
+
+    auto c = alloc.allocate({64, 64});
+    ASSERT_TRUE(c.has_value());
+    EXPECT_TRUE(c->x >= 64 || c->y >= 64);
+
+    EXPECT_TRUE(alloc.deallocate(*a));
+    EXPECT_TRUE(alloc.deallocate(*b));
+    EXPECT_TRUE(alloc.deallocate(*c));
+    EXPECT_EQ(alloc.remain_area(), alloc.extent().area());
+
+    auto full = alloc.allocate({128, 128});
+    ASSERT_TRUE(full.has_value());
+    EXPECT_EQ(*full, (usize2{0, 0}));
+    EXPECT_TRUE(alloc.deallocate(*full));
+}
+
+TEST(Allocator2D, GrowFromEmptyAllocator) {
+    mo_yanxi::allocator2d<> alloc{std::allocator<std::byte>{}};
+    EXPECT_FALSE(alloc.allocate({1, 1}).has_value());
+
+    ASSERT_TRUE(alloc.grow({32, 16}));
+    auto a = alloc.allocate({32, 16});
+    ASSERT_TRUE(a.has_value());
+    EXPECT_TRUE(alloc.deallocate(*a));
+
+    ASSERT_TRUE(alloc.grow({32, 48}));
+    auto b = alloc.allocate({32, 48});
+    ASSERT_TRUE(b.has_value());
+    EXPECT_TRUE(alloc.deallocate(*b));
+}
+
+TEST(Allocator2D, UsedBoundsFollowLiveAllocations) {
+    mo_yanxi::allocator2d<> alloc{{128, 128}};
+    EXPECT_EQ(alloc.used_bounds(), (usize2{0, 0}));
+
+    auto a = alloc.allocate({32, 16});
+    auto b = alloc.allocate({64, 48});
+    ASSERT_TRUE(a.has_value());
+    ASSERT_TRUE(b.has_value());
+
+    const usize2 expected{std::max(a->x + 32, b->x + 64), std::max(a->y + 16, b->y + 48)};
+    EXPECT_EQ(alloc.used_bounds(), expected);
+
+    EXPECT_TRUE(alloc.deallocate(*b));
+    EXPECT_EQ(alloc.used_bounds(), (usize2{a->x + 32, a->y + 16}));
+
+    EXPECT_TRUE(alloc.deallocate(*a));
+    EXPECT_EQ(alloc.used_bounds(), (usize2{0, 0}));
+}
+
+TEST(Allocator2D, TrimDropsFreeStripsAndUndoesGrow) {
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+
+    auto a = alloc.allocate({32, 16});
+    ASSERT_TRUE(a.has_value());
+    EXPECT_EQ(*a, (usize2{0, 0}));
+
+    ASSERT_TRUE(alloc.grow({256, 256}));
+    EXPECT_EQ(alloc.trim(), (usize2{32, 16}));
+    EXPECT_EQ(alloc.extent(), alloc.used_bounds());
+    EXPECT_EQ(alloc.remain_area(), 0u);
+    EXPECT_FALSE(alloc.allocate({1, 1}).has_value());
+
+    ASSERT_TRUE(alloc.grow({64, 32}));
+    auto b = alloc.allocate({32, 32});
+    ASSERT_TRUE(b.has_value());
+    EXPECT_EQ(*b, (usize2{32, 0}));
+
+    EXPECT_TRUE(alloc.deallocate(*a));
+    EXPECT_EQ(alloc.trim(), (usize2{64, 32}));
+
+    EXPECT_TRUE(alloc.deallocate(*b));
+    EXPECT_EQ(alloc.remain_area(), alloc.extent().area());
+    auto full = alloc.allocate({64, 32});
+    ASSERT_TRUE(full.has_value());
+    EXPECT_TRUE(alloc.deallocate(*full));
+
+    // with nothing allocated every strip is free, so the extent trims away entirely
+    EXPECT_EQ(alloc.trim(), (usize2{0, 0}));
+    EXPECT_EQ(alloc.remain_area(), 0u);
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_FALSE(alloc.allocate({1, 1}).has_value());
+    ASSERT_TRUE(alloc.grow({16, 0}));
+    EXPECT_FALSE(alloc.allocate({1, 1}).has_value());
+    ASSERT_TRUE(alloc.grow({16, 8}));
+    EXPECT_EQ(alloc.allocate({16, 8}), (usize2{0, 0}));
+    EXPECT_TRUE(alloc.validate());
+
+    // the same holds while the subtree search keeps its summaries
+    mo_yanxi::allocator2d<> subtree{{64, 64}};
+    subtree.use_subtree_search(true);
+    const auto corner = subtree.allocate({8, 8});
+    ASSERT_TRUE(corner.has_value());
+    ASSERT_TRUE(subtree.deallocate(*corner));
+    EXPECT_EQ(subtree.trim(), (usize2{0, 0}));
+    EXPECT_TRUE(subtree.validate());
+    ASSERT_TRUE(subtree.grow({32, 32}));
+    EXPECT_EQ(subtree.allocate({32, 32}), (usize2{0, 0}));
+    EXPECT_TRUE(subtree.validate());
+}
+
+TEST(Allocator2D, DirtyRegionsAreCoalesced) {
+    using region = mo_yanxi::allocator2d<>::region;
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+
+    EXPECT_TRUE(alloc.allocate({8, 8}).has_value());
+    EXPECT_TRUE(alloc.take_dirty().empty());
+
+    alloc.track_dirty(true);
+    auto a = alloc.allocate({32, 16});
+    auto b = alloc.allocate({24, 8});
+    ASSERT_TRUE(a.has_value());
+    ASSERT_TRUE(b.has_value());
+
+    auto dirty = alloc.take_dirty();
+    std::uint64_t dirty_area = 0;
+    for (const auto& rect : dirty) {
+        dirty_area += rect.extent.area();
+    }
+    EXPECT_LE(dirty.size(), 2u);
+    EXPECT_EQ(dirty_area, 32u * 16u + 24u * 8u);
+    EXPECT_TRUE(alloc.take_dirty().empty());
+
+    EXPECT_TRUE(alloc.deallocate(*a));
+    auto c = alloc.allocate({32, 16});
+    ASSERT_TRUE(c.has_value());
+    EXPECT_EQ(*c, *a);
+
+    dirty = alloc.take_dirty();
+    ASSERT_EQ(dirty.size(), 1u);
+    EXPECT_EQ(dirty.front(), (region{*a, {32, 16}}));
+
+    EXPECT_TRUE(alloc.deallocate(*b));
+    EXPECT_TRUE(alloc.deallocate(*c));
+    dirty = alloc.take_dirty();
+    ASSERT_EQ(dirty.size(), 2u);
+
+    alloc.track_dirty(false);
+    EXPECT_TRUE(alloc.deallocate({0, 0}));
+    EXPECT_TRUE(alloc.take_dirty().empty());
+}
+
+TEST(Allocator2D, EnumeratesRegionsAndQueriesOverlaps) {
+    using region = mo_yanxi::allocator2d<>::region;
+    mo_yanxi::allocator2d<> alloc{{256, 256}};
+    std::mt19937 rng(5);
+    std::uniform_int_distribution<std::uint32_t> size_dist(4, 40);
+
+    std::vector<region> live;
+    for (int i = 0; i < 300; ++i) {
+        const usize2 size{size_dist(rng), size_dist(rng)};
+        if (auto pos = alloc.allocate(size)) {
+            live.push_back({*pos, size});
+        }
+    }
+    std::ranges::shuffle(live, rng);
+    for (std::size_t i = 0; i < live.size() / 3; ++i) {
+        EXPECT_TRUE(alloc.deallocate(live.back().src));
+        live.pop_back();
+    }
+    // reuse freed bodies so that body roots show up in the walk
+    for (int i = 0; i < 100; ++i) {
+        const usize2 size{size_dist(rng) / 2, size_dist(rng) / 2};
+        if (auto pos = alloc.allocate(size)) {
+            live.push_back({*pos, size});
+        }
+    }
+
+    const auto by_position = [](const region& lhs, const region& rhs) {
+        return std::pair{lhs.src.y, lhs.src.x} < std::pair{rhs.src.y, rhs.src.x};
+    };
+
+    std::vector<region> listed;
+    for (const auto& rect : alloc.allocations()) {
+        listed.push_back(rect);
+    }
+    std::ranges::sort(listed, by_position);
+    std::ranges::sort(live, by_position);
+    EXPECT_EQ(listed, live);
+
+    std::uint64_t free_area = 0;
+    for (const auto& rect : alloc.free_regions()) {
+        free_area += rect.extent.area();
+        for (const auto& used : live) {
+            EXPECT_FALSE(rect.overlaps(used));
+        }
+    }
+    EXPECT_EQ(free_area, alloc.remain_area());
+
+    for (const region area : {region{{0, 0}, {256, 256}}, region{{40, 60}, {70, 30}}, region{{128, 0}, {1, 256}}}) {
+        auto found = alloc.query(area);
+        std::vector<region> expected;
+        for (const auto& rect : live) {
+            if (rect.overlaps(area)) expected.push_back(rect);
+        }
+        std::ranges::sort(found, by_position);
+        std::ranges::sort(expected, by_position);
+        EXPECT_EQ(std::vector<region>(found.begin(), found.end()), expected);
+    }
+
+    for (const auto& rect : live) {
+        EXPECT_TRUE(alloc.deallocate(rect.src));
+    }
+    EXPECT_EQ(alloc.remain_area(), alloc.extent().area());
+}
+
+TEST(Allocator2D, EvictsCheapestSubtreeToFit) {
+    using region = mo_yanxi::allocator2d<>::region;
+    mo_yanxi::allocator2d<> alloc{{128, 128}};
+
+    // fill with 16x16 tiles, stamped with their allocation order as an age
+    std::map<std::pair<std::uint32_t, std::uint32_t>, int> age;
+    for (int i = 0; auto pos = alloc.allocate({16, 16}); ++i) {
+        age[{pos->x, pos->y}] = i;
+    }
+    ASSERT_EQ(age.size(), 64u);
+    ASSERT_FALSE(alloc.allocate({32, 32}));
+
+    const auto cost = [&](const region& rect) { return 1 + age.at({rect.src.x, rect.src.y}); };
+    std::vector<region> evicted;
+    const auto pos = alloc.allocate_with_eviction({32, 32}, cost, [&](const region& rect) {
+        evicted.push_back(rect);
+        age.erase({rect.src.x, rect.src.y});
+    });
+    ASSERT_TRUE(pos);
+
+    // a 32x32 hole needs at least four tiles; the tree should not clear much more than that
+    EXPECT_GE(evicted.size(), 4u);
+    EXPECT_LE(evicted.size(), 8u);
+
+    const region placed{*pos, {32, 32}};
+    for (const auto& [point, _] : age) {
+        EXPECT_FALSE(placed.overlaps(region{{point.first, point.second}, {16, 16}}));
+    }
+    EXPECT_EQ(alloc.remain_area(), 128u * 128 - age.size() * 256 - 32 * 32);
+
+    // an extent larger than the allocator never evicts
+    EXPECT_FALSE(alloc.allocate_with_eviction({256, 16}, cost));
+    EXPECT_EQ(alloc.remain_area(), 128u * 128 - age.size() * 256 - 32 * 32);
+}
+
+TEST(Allocator2D, RandomChurnKeepsInvariants) {
+    using region = mo_yanxi::allocator2d<>::region;
+    for (std::uint32_t seed = 0; seed < 8; ++seed) {
+        std::mt19937 rng(seed);
+        mo_yanxi::allocator2d<> alloc{{96, 80}, seed % 2 ? 64u : 0u};
+        ASSERT_TRUE(alloc.validate());
+
+        std::vector<region> live;
+        const auto forget = [&](const region& rect) {
+            const auto it = std::ranges::find(live, rect);
+            ASSERT_NE(it, live.end());
+            *it = live.back();
+            live.pop_back();
+        };
+
+        for (int step = 0; step < 1500; ++step) {
+            const auto op = rng() % 100;
+            const usize2 size{1 + static_cast<std::uint32_t>(rng() % 24), 1 + static_cast<std::uint32_t>(rng() % 24)};
+            if (op < 2) {
+                const auto extent = alloc.extent();
+                if (extent.x < 256 && extent.y < 256) {
+                    ASSERT_TRUE(alloc.grow({extent.x + static_cast<std::uint32_t>(rng() % 32), extent.y + 8}));
+                }
+            } else if (op < 4) {
+                alloc.trim();
+            } else if (op < 8) {
+                const auto cost = [](const region& rect) { return (rect.src.x * 31 + rect.src.y) % 17; };
+                if (const auto pos = alloc.allocate_with_eviction(size, cost, forget)) {
+                    live.push_back({*pos, size});
+                }
+            } else if (live.empty() || op < 55) {
+                if (const auto pos = alloc.allocate(size)) {
+                    live.push_back({*pos, size});
+                }
+            } else {
+                const auto index = rng() % live.size();
+                ASSERT_TRUE(alloc.deallocate(live[index].src));
+                live[index] = live.back();
+                live.pop_back();
+            }
+            ASSERT_TRUE(alloc.validate()) << "seed " << seed << " step " << step;
+        }
+
+        for (std::size_t i = 0; i < live.size(); ++i) {
+            for (std::size_t j = i + 1; j < live.size(); ++j) {
+                ASSERT_FALSE(live[i].overlaps(live[j]));
+            }
+        }
+        for (const auto& rect : live) {
+            ASSERT_TRUE(alloc.deallocate(rect.src));
+        }
+        EXPECT_TRUE(alloc.validate());
+        EXPECT_EQ(alloc.remain_area(), alloc.extent().area());
+    }
+}
+
+TEST(Allocator2D, NarrowCoordinatesMatchWideCoordinates) {
+    using narrow_type = mo_yanxi::allocator2d<std::allocator<std::byte>, std::uint16_t>;
+    using narrow2 = narrow_type::extent_type;
+    const auto narrow = [](const usize2 v) { return narrow2{static_cast<std::uint16_t>(v.x), static_cast<std::uint16_t>(v.y)}; };
+
+    // a full-range 16-bit product wraps like its type instead of overflowing int; area_of stays exact
+    static_assert(narrow2{65535, 65535}.area() == 1);
+    static_assert(mo_yanxi::area_of(narrow2{65535, 65535}) == 65535ull * 65535);
+
+    for (const bool subtree : {false, true}) {
+        std::mt19937 rng(23);
+        mo_yanxi::allocator2d<> wide{{1024, 768}, 256};
+        narrow_type thin{{1024, 768}, 256};
+        wide.use_subtree_search(subtree);
+        thin.use_subtree_search(subtree);
+
+        // the same requests must land on the same points whatever the coordinate width
+        std::vector<usize2> live;
+        for (int step = 0; step < 6000; ++step) {
+            const auto op = rng() % 100;
+            const usize2 size{1 + static_cast<std::uint32_t>(rng() % 64), 1 + static_cast<std::uint32_t>(rng() % 64)};
+            if (op < 2) {
+                const auto extent = wide.extent();
+                if (extent.x < 4096) {
+                    const usize2 grown{extent.x + 64, extent.y + 32};
+                    ASSERT_TRUE(wide.grow(grown));
+                    ASSERT_TRUE(thin.grow(narrow(grown)));
+                }
+            } else if (op < 4) {
+                ASSERT_EQ(narrow(wide.trim()), thin.trim());
+            } else if (live.empty() || op < 55) {
+                const auto pos = wide.allocate(size);
+                const auto thin_pos = thin.allocate(narrow(size));
+                ASSERT_EQ(pos.has_value(), thin_pos.has_value()) << "step " << step;
+                if (pos) {
+                    ASSERT_EQ(narrow(*pos), *thin_pos) << "step " << step;
+                    live.push_back(*pos);
+                }
+            } else {
+                const auto index = rng() % live.size();
+                ASSERT_TRUE(wide.deallocate(live[index]));
+                ASSERT_TRUE(thin.deallocate(narrow(live[index])));
+                live[index] = live.back();
+                live.pop_back();
+            }
+            ASSERT_EQ(wide.remain_area(), thin.remain_area());
+        }
+        EXPECT_TRUE(thin.validate());
+        EXPECT_LT(thin.memory_usage().total(), wide.memory_usage().total());
+    }
+
+    // the full 16-bit range, where the area no longer fits the coordinate type
+    narrow_type full{{65535, 65535}};
+    const auto strip = full.allocate({65535, 1});
+    const auto column = full.allocate({1, 65534});
+    ASSERT_TRUE(strip && column);
+    EXPECT_EQ(full.remain_area(), 65534ull * 65534ull);
+    EXPECT_TRUE(full.deallocate(*strip));
+    EXPECT_TRUE(full.deallocate(*column));
+    EXPECT_EQ(full.remain_area(), 65535ull * 65535ull);
+    EXPECT_TRUE(full.validate());
+}
+
+TEST(ShelfPacker, SeedsAllocatorWithItsLayout) {
+    using region = mo_yanxi::allocator2d<>::region;
+    std::mt19937 rng(11);
+    std::uniform_int_distribution<std::uint32_t> size_dist(4, 48);
+    std::vector<usize2> sizes(600);
+    for (auto& size : sizes) {
+        size = {size_dist(rng), size_dist(rng)};
+    }
+
+    mo_yanxi::shelf_packer<> packer{{512, 512}};
+    const auto positions = packer.pack_all(sizes);
+    ASSERT_EQ(positions.size(), sizes.size());
+
+    std::uint64_t packed_area = 0;
+    for (std::size_t i = 0; i < sizes.size(); ++i) {
+        if (positions[i]) packed_area += sizes[i].area();
+    }
+    EXPECT_GT(packed_area, 512u * 512 * 8 / 10);
+    EXPECT_EQ(packer.regions().size(), static_cast<std::size_t>(std::ranges::count_if(positions, [](const auto& pos) { return pos.has_value(); })));
+
+    auto seeded = mo_yanxi::allocator2d<>::from_layout(packer.extent(), packer.regions());
+    ASSERT_TRUE(seeded);
+    EXPECT_TRUE(seeded->validate());
+    EXPECT_EQ(seeded->remain_area(), 512u * 512 - packed_area);
+
+    std::vector<region> expected(packer.regions().begin(), packer.regions().end());
+    std::vector<region> adopted(seeded->allocations().begin(), seeded->allocations().end());
+    const auto by_position = [](const region& lhs, const region& rhs) {
+        return std::pair{lhs.src.y, lhs.src.x} < std::pair{rhs.src.y, rhs.src.x};
+    };
+    std::ranges::sort(expected, by_position);
+    std::ranges::sort(adopted, by_position);
+    EXPECT_EQ(adopted, expected);
+
+    // the leftover space keeps serving runtime allocations
+    std::vector<usize2> runtime;
+    while (const auto pos = seeded->allocate({8, 8})) {
+        runtime.push_back(*pos);
+    }
+    EXPECT_FALSE(runtime.empty());
+    EXPECT_TRUE(seeded->validate());
+    for (const auto& pos : runtime) {
+        EXPECT_TRUE(seeded->deallocate(pos));
+    }
+    for (const auto& rect : expected) {
+        EXPECT_TRUE(seeded->deallocate(rect.src));
+    }
+    EXPECT_TRUE(seeded->validate());
+    EXPECT_EQ(seeded->remain_area(), 512u * 512);
+
+    // layouts that overlap or leave the extent are rejected
+    const region overlapping[] = {{{0, 0}, {10, 10}}, {{5, 5}, {10, 10}}};
+    EXPECT_FALSE(mo_yanxi::allocator2d<>::from_layout({64, 64}, overlapping));
+    const region outside[] = {{{60, 0}, {10, 10}}};
+    EXPECT_FALSE(mo_yanxi::allocator2d<>::from_layout({64, 64}, outside));
+    // a pinwheel cannot be cut by guillotine cuts
+    const region pinwheel[] = {{{0, 0}, {20, 10}}, {{20, 0}, {10, 20}}, {{10, 20}, {20, 10}}, {{0, 10}, {10, 20}}};
+    EXPECT_FALSE(mo_yanxi::allocator2d<>::from_layout({30, 30}, pinwheel));
+}
+
+TEST(ShelfPacker, PacksAtCompileTime) {
+    constexpr usize2 sizes[] = {{64, 32}, {16, 16}, {200, 48}, {48, 16}, {100, 40}, {300, 300}, {32, 32}};
+    constexpr auto layout = mo_yanxi::pack_shelves({256, 256}, {{64, 32}, {16, 16}, {200, 48}, {48, 16}, {100, 40}, {300, 300}, {32, 32}});
+    static_assert(layout.placed_count == 6);
+    static_assert(!layout.positions[5]);
+    static_assert(layout.positions[2] == usize2{0, 0});
+    static_assert(layout.used_height == 48 + 40);
+
+    // same placements as the runtime packer
+    mo_yanxi::shelf_packer<> packer{{256, 256}};
+    const auto positions = packer.pack_all(sizes);
+    ASSERT_EQ(positions.size(), layout.positions.size());
+    EXPECT_TRUE(std::ranges::equal(positions, layout.positions));
+    EXPECT_TRUE(std::ranges::equal(packer.regions(), layout.regions()));
+
+    auto seeded = mo_yanxi::allocator2d<>::from_layout(layout.extent, layout.regions());
+    ASSERT_TRUE(seeded);
+    EXPECT_TRUE(seeded->validate());
+    for (const auto& rect : layout.regions()) {
+        EXPECT_TRUE(seeded->deallocate(rect.src));
+    }
+    EXPECT_EQ(seeded->remain_area(), 256u * 256);
+}
+
+TEST(Allocator2D, ReserveAndAdoptPrePlacedRects) {
+    using region = mo_yanxi::allocator2d<>::region;
+    const auto by_position = [](const region& lhs, const region& rhs) {
+        return std::pair{lhs.src.y, lhs.src.x} < std::pair{rhs.src.y, rhs.src.x};
+    };
+    const auto sorted_allocations = [&](const mo_yanxi::allocator2d<>& alloc) {
+        std::vector<region> result(alloc.allocations().begin(), alloc.allocations().end());
+        std::ranges::sort(result, by_position);
+        return result;
+    };
+
+    // bake a layout through ordinary churn
+    mo_yanxi::allocator2d<> baked{{300, 200}};
+    std::mt19937 rng(21);
+    std::vector<usize2> live;
+    for (int i = 0; i < 800; ++i) {
+        if (live.empty() || rng() % 3) {
+            if (auto pos = baked.allocate({1 + static_cast<std::uint32_t>(rng() % 30), 1 + static_cast<std::uint32_t>(rng() % 30)})) {
+                live.push_back(*pos);
+            }
+        } else {
+            const auto index = rng() % live.size();
+            baked.deallocate(live[index]);
+            live[index] = live.back();
+            live.pop_back();
+        }
+    }
+    const auto layout = sorted_allocations(baked);
+
+    mo_yanxi::allocator2d<> restored{{300, 200}};
+    ASSERT_TRUE(restored.adopt(layout));
+    EXPECT_TRUE(restored.validate());
+    EXPECT_EQ(sorted_allocations(restored), layout);
+    EXPECT_EQ(restored.remain_area(), baked.remain_area());
+
+    // adopting anything overlapping a live allocation is rejected without side effects
+    EXPECT_FALSE(restored.adopt(std::span{layout}.first(1)));
+    EXPECT_FALSE(restored.reserve(layout.front().src, {1, 1}));
+    EXPECT_EQ(sorted_allocations(restored), layout);
+    EXPECT_TRUE(restored.validate());
+
+    // reserve inside a free region, away from its corner
+    region free_region{};
+    for (const auto& rect : restored.free_regions()) {
+        if (rect.extent.x >= 4 && rect.extent.y >= 4) {
+            free_region = rect;
+            break;
+        }
+    }
+    ASSERT_GE(free_region.extent.x, 4u);
+    const region reserved{{free_region.src.x + 1, free_region.src.y + 2}, {free_region.extent.x - 3, free_region.extent.y - 3}};
+    const auto remain = restored.remain_area();
+    ASSERT_TRUE(restored.reserve(reserved.src, reserved.extent));
+    EXPECT_TRUE(restored.validate());
+    EXPECT_EQ(restored.remain_area(), remain - reserved.extent.area());
+
+    // everything adopted or reserved is released like an ordinary allocation
+    EXPECT_TRUE(restored.deallocate(reserved.src));
+    for (const auto& rect : layout) {
+        EXPECT_TRUE(restored.deallocate(rect.src));
+    }
+    EXPECT_TRUE(restored.validate());
+    EXPECT_EQ(restored.remain_area(), 300u * 200);
+    EXPECT_TRUE(restored.allocate({300, 200}));
+}
+
+TEST(Allocator2D, RotatableAllocationUsesEitherOrientation) {
+    mo_yanxi::allocator2d<> alloc{{100, 40}};
+
+    // only fits lying down
+    const auto wide = alloc.allocate_rotatable({40, 90});
+    ASSERT_TRUE(wide);
+    EXPECT_TRUE(wide->rotated);
+    EXPECT_TRUE(alloc.is_rotated(wide->point));
+    EXPECT_EQ(alloc.remain_area(), 100u * 40 - 90 * 40);
+
+    // the 10 x 40 strip left over takes a 40 x 10 rect only when rotated
+    EXPECT_FALSE(alloc.allocate({40, 10}));
+    const auto strip = alloc.allocate_rotatable({40, 10});
+    ASSERT_TRUE(strip);
+    EXPECT_TRUE(strip->rotated);
+    EXPECT_EQ(alloc.remain_area(), 0u);
+
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_TRUE(alloc.deallocate(wide->point));
+    EXPECT_FALSE(alloc.is_rotated(wide->point));
+
+    // the requested orientation is kept when it fits as well
+    const auto square_fit = alloc.allocate_rotatable({20, 20});
+    ASSERT_TRUE(square_fit);
+    EXPECT_FALSE(square_fit->rotated);
+    const auto upright = alloc.allocate_rotatable({30, 10});
+    ASSERT_TRUE(upright);
+    EXPECT_FALSE(upright->rotated);
+    EXPECT_FALSE(alloc.is_rotated(upright->point));
+
+    EXPECT_TRUE(alloc.deallocate(square_fit->point));
+    EXPECT_TRUE(alloc.deallocate(upright->point));
+    EXPECT_TRUE(alloc.deallocate(strip->point));
+    EXPECT_EQ(alloc.remain_area(), 100u * 40);
+    EXPECT_FALSE(alloc.allocate_rotatable({101, 101}));
+}
+
+TEST(LayeredAllocator, BalancesLayersAndSharesMipPositions) {
+    using layered = mo_yanxi::layered_allocator2d<>;
+
+    // balanced spreads equal requests over the layers, first_fit stacks them in layer 0
+    layered balanced{{64, 64}, 3};
+    layered packed{{64, 64}, 3, layered::layer_policy::first_fit};
+    for (std::uint32_t i = 0; i < 3; ++i) {
+        const auto spread = balanced.allocate({32, 32});
+        ASSERT_TRUE(spread);
+        EXPECT_EQ(spread->layer, i);
+        const auto stacked = packed.allocate({32, 32});
+        ASSERT_TRUE(stacked);
+        EXPECT_EQ(stacked->layer, 0u);
+    }
+    EXPECT_EQ(balanced.layer(0).max_free_extent(), (mo_yanxi::math::usize2{32, 64}));
+
+    // no layer is empty any more, and the summaries say so without a search
+    EXPECT_FALSE(balanced.allocate({64, 64}));
+    const auto tall = balanced.allocate({32, 64});
+    ASSERT_TRUE(tall);
+    EXPECT_EQ(balanced.remain_area(), 3u * 64 * 64 - 3 * 32 * 32 - 32 * 64);
+
+    // a 3-level mip allocation is aligned to 4 texels on an unaligned layer
+    layered mips{{64, 64}, 1};
+    ASSERT_TRUE(mips.allocate({3, 5}));
+    const auto mip = mips.allocate_mip({10, 6}, 3);
+    ASSERT_TRUE(mip);
+    EXPECT_EQ(mip->point.x % 4, 0u);
+    EXPECT_EQ(mip->point.y % 4, 0u);
+    EXPECT_EQ(mip->extent, (mo_yanxi::math::usize2{12, 8}));
+    EXPECT_TRUE(mips.layer(0).validate());
+    EXPECT_EQ(mips.remain_area(), 64u * 64 - 3 * 5 - 12 * 8);
+    EXPECT_FALSE(mips.allocate_mip({1, 1}, 8));
+
+    EXPECT_TRUE(mips.deallocate(*mip));
+    EXPECT_FALSE(mips.deallocate(*mip));
+    EXPECT_FALSE(mips.deallocate(5, {0, 0}));
+    EXPECT_TRUE(mips.deallocate(0, {0, 0}));
+    EXPECT_EQ(mips.remain_area(), 64u * 64);
+}
+
+TEST(Allocator2D, FindAlignedMatchesAScanOfFreeRegions) {
+    using region = mo_yanxi::allocator2d<>::region;
+    // the default threshold keeps most regions in the fragment index, 16 most in the large one
+    for (int config = 0; config < 3; ++config) {
+        std::mt19937 rng{static_cast<std::uint32_t>(40 + config)};
+        mo_yanxi::allocator2d<> alloc{{128, 96}, config == 1 ? 16u : 0u};
+        alloc.use_subtree_search(config == 2);
+
+        std::vector<region> live;
+        for (int step = 0; step < 1500; ++step) {
+            const usize2 extent{1 + static_cast<std::uint32_t>(rng() % 20), 1 + static_cast<std::uint32_t>(rng() % 20)};
+            const auto alignment = 1u << (rng() % 4);
+
+            std::uint64_t best_area = std::numeric_limits<std::uint64_t>::max();
+            for (const auto& free : alloc.free_regions()) {
+                const usize2 aligned{(free.src.x + alignment - 1) / alignment * alignment, (free.src.y + alignment - 1) / alignment * alignment};
+                if (free.contains({aligned, extent})) best_area = std::min(best_area, mo_yanxi::area_of(free.extent));
+            }
+
+            const auto found = alloc.find_aligned(extent, alignment);
+            if (best_area == std::numeric_limits<std::uint64_t>::max()) {
+                ASSERT_FALSE(found) << "config " << config << " step " << step;
+            } else {
+                ASSERT_TRUE(found) << "config " << config << " step " << step;
+                EXPECT_EQ(found->x % alignment, 0u);
+                EXPECT_EQ(found->y % alignment, 0u);
+                std::uint64_t holder_area = 0;
+                for (const auto& free : alloc.free_regions()) {
+                    if (free.contains({*found, extent})) holder_area = mo_yanxi::area_of(free.extent);
+                }
+                EXPECT_EQ(holder_area, best_area) << "config " << config << " step " << step;
+            }
+
+            if (found && (live.empty() || rng() % 3)) {
+                ASSERT_TRUE(alloc.reserve(*found, extent));
+                live.push_back({*found, extent});
+            } else if (!live.empty()) {
+                const auto index = rng() % live.size();
+                ASSERT_TRUE(alloc.deallocate(live[index].src));
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        EXPECT_TRUE(alloc.validate());
+    }
+}
+
+TEST(Allocator2D, AdaptiveFragmentThresholdFollowsRequests) {
+    mo_yanxi::allocator2d<> alloc{{1024, 1024}};
+    const auto initial = alloc.fragment_threshold();
+    alloc.adapt_fragment_threshold(true);
+
+    // glyph-sized requests pull the threshold down to 4-8 times their area
+    std::vector<mo_yanxi::math::usize2> live;
+    for (int i = 0; i < 256; ++i) {
+        const auto pos = alloc.allocate({4, 4});
+        ASSERT_TRUE(pos);
+        live.push_back(*pos);
+        ASSERT_TRUE(alloc.validate());
+    }
+    EXPECT_LT(alloc.fragment_threshold(), initial);
+    EXPECT_EQ(alloc.fragment_threshold(), 128u);
+
+    // icon-sized requests push it back up once they dominate the histogram
+    for (int i = 0; i < 512; ++i) {
+        const auto pos = alloc.allocate({24, 24});
+        ASSERT_TRUE(pos);
+        live.push_back(*pos);
+        ASSERT_TRUE(alloc.validate());
+    }
+    EXPECT_EQ(alloc.fragment_threshold(), 4096u);
+
+    // disabling keeps the current threshold
+    alloc.adapt_fragment_threshold(false);
+    for (int i = 0; i < 512; ++i) {
+        if (const auto pos = alloc.allocate({2, 2})) live.push_back(*pos);
+    }
+    EXPECT_EQ(alloc.fragment_threshold(), 4096u);
+    EXPECT_TRUE(alloc.validate());
+
+    for (const auto pos : live) {
+        EXPECT_TRUE(alloc.deallocate(pos));
+    }
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_TRUE(alloc.allocate({1024, 1024}));
+}
+
+TEST(Allocator2D, FragmentTiesPreferTheLowestPoint) {
+    // every free region counts as a fragment, so equal holes share one bucket group
+    mo_yanxi::allocator2d<> alloc{{128, 32}, 128 * 32};
+    std::vector<usize2> cells;
+    for (std::uint32_t i = 0; i < 16; ++i) {
+        const auto pos = alloc.allocate({16, 16});
+        ASSERT_TRUE(pos);
+        cells.push_back(*pos);
+    }
+    EXPECT_EQ(alloc.remain_area(), 0u);
+
+    const usize2 holes[] = {{32, 16}, {96, 0}, {64, 16}};
+    for (const auto hole : holes) {
+        ASSERT_TRUE(alloc.deallocate(hole));
+    }
+    EXPECT_TRUE(alloc.validate());
+
+    for (const usize2 expected : {usize2{96, 0}, usize2{32, 16}, usize2{64, 16}}) {
+        const auto pos = alloc.allocate({16, 16});
+        ASSERT_TRUE(pos);
+        EXPECT_EQ(*pos, expected);
+    }
+    EXPECT_FALSE(alloc.allocate({1, 1}));
+
+    for (const auto cell : cells) {
+        EXPECT_TRUE(alloc.deallocate(cell));
+    }
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_EQ(alloc.max_free_extent(), (usize2{128, 32}));
+}
+
+TEST(Allocator2D, SubtreeSearchPrunesAndSwitchesBack) {
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+    alloc.use_subtree_search(true);
+    EXPECT_TRUE(alloc.uses_subtree_search());
+    EXPECT_EQ(alloc.max_free_extent(), (mo_yanxi::math::usize2{64, 64}));
+
+    // equal cells tile the extent exactly, the first one at the origin
+    std::vector<mo_yanxi::math::usize2> live;
+    for (int i = 0; i < 16; ++i) {
+        const auto pos = alloc.allocate({16, 16});
+        ASSERT_TRUE(pos);
+        if (i == 0) {
+            EXPECT_EQ(*pos, (mo_yanxi::math::usize2{0, 0}));
+        }
+        live.push_back(*pos);
+        ASSERT_TRUE(alloc.validate());
+    }
+    EXPECT_EQ(alloc.remain_area(), 0u);
+    EXPECT_EQ(alloc.max_free_extent(), (mo_yanxi::math::usize2{0, 0}));
+    EXPECT_FALSE(alloc.allocate({1, 1}));
+
+    // a released cell is the only subtree left to descend into
+    EXPECT_TRUE(alloc.deallocate(live[5]));
+    EXPECT_EQ(alloc.max_free_extent(), (mo_yanxi::math::usize2{16, 16}));
+    EXPECT_FALSE(alloc.allocate({17, 1}));
+    const auto reused = alloc.allocate_rotatable({16, 8});
+    ASSERT_TRUE(reused);
+    EXPECT_EQ(reused->point, live[5]);
+    EXPECT_FALSE(reused->rotated);
+    EXPECT_TRUE(alloc.validate());
+
+    // switching engines with live allocations rebuilds the indexes
+    alloc.use_subtree_search(false);
+    EXPECT_FALSE(alloc.uses_subtree_search());
+    EXPECT_TRUE(alloc.validate());
+    const auto rest = alloc.allocate({16, 8});
+    ASSERT_TRUE(rest);
+    EXPECT_TRUE(alloc.deallocate(*rest));
+    alloc.use_subtree_search(true);
+    EXPECT_TRUE(alloc.validate());
+
+    EXPECT_TRUE(alloc.deallocate(reused->point));
+    for (const auto pos : live) {
+        if (pos != live[5]) {
+            EXPECT_TRUE(alloc.deallocate(pos));
+        }
+    }
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_EQ(alloc.max_free_extent(), (mo_yanxi::math::usize2{64, 64}));
+    EXPECT_TRUE(alloc.allocate({64, 64}));
+}
+
+namespace {
+
+// eager coroutine that keeps its frame until destroyed, so a test can drop it while it is parked
+struct parked_task {
+    struct promise_type {
+        parked_task get_return_object() { return {std::coroutine_handle<promise_type>::from_promise(*this)}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); }
+    };
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+parked_task await_allocation(mo_yanxi::allocator2d<>& alloc, const usize2 extent, std::optional<usize2>& result, bool& done) {
+    result = co_await alloc.allocate_async(extent);
+    done = true;
+}
+
+}
+
+TEST(Allocator2D, AsyncAllocationResumesWhenSpaceFrees) {
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+    std::vector<usize2> quarters;
+    for (int i = 0; i < 4; ++i) {
+        const auto pos = alloc.allocate({32, 32});
+        ASSERT_TRUE(pos);
+        quarters.push_back(*pos);
+    }
+
+    // fits right away: completes without suspending
+    std::optional<usize2> empty_result;
+    bool empty_done = false;
+    auto empty = await_allocation(alloc, {0, 0}, empty_result, empty_done);
+    EXPECT_TRUE(empty_done);
+    EXPECT_FALSE(empty_result);
+    empty.handle.destroy();
+
+    std::optional<usize2> small_result, large_result, dropped_result;
+    bool small_done = false, large_done = false, dropped_done = false;
+    auto large = await_allocation(alloc, {64, 64}, large_result, large_done);
+    auto small = await_allocation(alloc, {20, 20}, small_result, small_done);
+    auto dropped = await_allocation(alloc, {30, 30}, dropped_result, dropped_done);
+    EXPECT_FALSE(large_done || small_done || dropped_done);
+    EXPECT_EQ(alloc.waiter_count(), 3u);
+
+    // destroying a parked coroutine withdraws its request
+    dropped.handle.destroy();
+    EXPECT_EQ(alloc.waiter_count(), 2u);
+
+    // one freed quarter serves the small request only
+    ASSERT_TRUE(alloc.deallocate(quarters[0]));
+    EXPECT_TRUE(small_done);
+    EXPECT_FALSE(large_done);
+    ASSERT_TRUE(small_result);
+    EXPECT_EQ(*small_result, quarters[0]);
+    EXPECT_EQ(alloc.waiter_count(), 1u);
+
+    // the large request waits until everything has merged back
+    ASSERT_TRUE(alloc.deallocate(*small_result));
+    ASSERT_TRUE(alloc.deallocate(quarters[1]));
+    ASSERT_TRUE(alloc.deallocate(quarters[2]));
+    EXPECT_FALSE(large_done);
+    ASSERT_TRUE(alloc.deallocate(quarters[3]));
+    EXPECT_TRUE(large_done);
+    ASSERT_TRUE(large_result);
+    EXPECT_EQ(*large_result, (usize2{0, 0}));
+    EXPECT_EQ(alloc.remain_area(), 0u);
+
+    // grow wakes requests too, and cancelled ones resume empty
+    std::optional<usize2> grown_result, cancelled_result;
+    bool grown_done = false, cancelled_done = false;
+    auto grown = await_allocation(alloc, {64, 16}, grown_result, grown_done);
+    auto cancelled = await_allocation(alloc, {128, 128}, cancelled_result, cancelled_done);
+    ASSERT_TRUE(alloc.grow({64, 80}));
+    ASSERT_TRUE(grown_done && grown_result);
+    EXPECT_EQ(*grown_result, (usize2{0, 64}));
+    EXPECT_FALSE(cancelled_done);
+    alloc.cancel_waiters();
+    EXPECT_TRUE(cancelled_done);
+    EXPECT_FALSE(cancelled_result);
+    EXPECT_EQ(alloc.waiter_count(), 0u);
+
+    for (auto* task : {&large, &small, &grown, &cancelled}) {
+        task->handle.destroy();
+    }
+    EXPECT_TRUE(alloc.deallocate(*large_result));
+    EXPECT_TRUE(alloc.deallocate(*grown_result));
+    EXPECT_TRUE(alloc.validate());
+
+    // parked requests follow the allocator when it is moved
+    const auto whole = alloc.allocate({64, 80});
+    ASSERT_TRUE(whole);
+    std::optional<usize2> moved_result;
+    bool moved_done = false;
+    auto moved_task = await_allocation(alloc, {8, 8}, moved_result, moved_done);
+    mo_yanxi::allocator2d<> moved{std::move(alloc)};
+    EXPECT_EQ(moved.waiter_count(), 1u);
+    ASSERT_TRUE(moved.deallocate(*whole));
+    EXPECT_TRUE(moved_done && moved_result);
+    moved_task.handle.destroy();
+    EXPECT_TRUE(moved.deallocate(*moved_result));
+}
+
+namespace {
+
+bool fail_allocations{};
+
+// fails every allocation while fail_allocations is set
+template <typename T>
+struct failing_allocator {
+    using value_type = T;
+
+    failing_allocator() = default;
+
+    template <typename U>
+    failing_allocator(const failing_allocator<U>&) noexcept {}
+
+    T* allocate(const std::size_t count) {
+        if (fail_allocations) throw std::bad_alloc{};
+        return std::allocator<T>{}.allocate(count);
+    }
+
+    void deallocate(T* ptr, const std::size_t count) noexcept {
+        std::allocator<T>{}.deallocate(ptr, count);
+    }
+
+    template <typename U>
+    bool operator==(const failing_allocator<U>&) const noexcept {
+        return true;
+    }
+};
+
+template <typename Allocator>
+parked_task await_allocation_in(Allocator& alloc, const usize2 extent, std::optional<usize2>& result, bool& done) {
+    result = co_await alloc.allocate_async(extent);
+    done = true;
+}
+
+}
+
+TEST(Allocator2D, WakingParkedRequestsIsNotANewRequest) {
+    // waking 200 parked requests must not count them again, which would cross the 256 request retarget
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+    alloc.adapt_fragment_threshold(true);
+    const auto initial = alloc.fragment_threshold();
+    const auto whole = alloc.allocate({64, 64});
+    ASSERT_TRUE(whole);
+
+    std::vector<parked_task> tasks(200);
+    std::vector<std::optional<usize2>> results(tasks.size());
+    // std::vector<bool> packs its elements, so give every task a real bool
+    auto done = std::make_unique<bool[]>(tasks.size());
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+        tasks[i] = await_allocation_in(alloc, {1, 1}, results[i], done[i]);
+    }
+    EXPECT_EQ(alloc.waiter_count(), tasks.size());
+    ASSERT_TRUE(alloc.deallocate(*whole));
+    EXPECT_EQ(alloc.waiter_count(), 0u);
+    EXPECT_EQ(alloc.fragment_threshold(), initial);
+    for (std::size_t i = 0; i < tasks.size(); ++i) {
+        EXPECT_TRUE(done[i] && results[i]);
+        tasks[i].handle.destroy();
+    }
+    EXPECT_TRUE(alloc.validate());
+}
+
+TEST(Allocator2D, EvictionCountsTheRequestOnce) {
+    using region = mo_yanxi::allocator2d<>::region;
+    // every call evicts the previous 1x1 block, so counting the retry too would cross the 256 request retarget
+    mo_yanxi::allocator2d<> alloc{{1, 1}};
+    alloc.adapt_fragment_threshold(true);
+    const auto initial = alloc.fragment_threshold();
+    const auto cost = [](const region&) { return 0; };
+    for (int i = 0; i < 200; ++i) {
+        ASSERT_TRUE(alloc.allocate_with_eviction({1, 1}, cost));
+    }
+    EXPECT_EQ(alloc.fragment_threshold(), initial);
+    EXPECT_TRUE(alloc.validate());
+}
+
+TEST(Allocator2D, EvictionServesParkedRequests) {
+    using region = mo_yanxi::allocator2d<>::region;
+    mo_yanxi::allocator2d<> alloc{{64, 64}};
+    ASSERT_TRUE(alloc.allocate({64, 64}));
+
+    std::optional<usize2> result;
+    bool done = false;
+    auto task = await_allocation_in(alloc, {16, 16}, result, done);
+    ASSERT_EQ(alloc.waiter_count(), 1u);
+
+    // the eviction frees the whole atlas, and the parked request fits next to the new block
+    const auto pos = alloc.allocate_with_eviction({32, 32}, [](const region&) { return 0; });
+    ASSERT_TRUE(pos);
+    EXPECT_TRUE(done);
+    ASSERT_TRUE(result);
+    EXPECT_FALSE((region{*pos, {32, 32}}).overlaps(region{*result, {16, 16}}));
+    EXPECT_EQ(alloc.waiter_count(), 0u);
+    EXPECT_TRUE(alloc.validate());
+    task.handle.destroy();
+}
+
+TEST(Allocator2D, FailedWakeThrowsFromDeallocate) {
+    mo_yanxi::allocator2d<failing_allocator<std::byte>> alloc{{64, 64}};
+    const auto whole = alloc.allocate({64, 64});
+    ASSERT_TRUE(whole);
+
+    std::optional<usize2> result;
+    bool done = false;
+    auto task = await_allocation_in(alloc, {8, 8}, result, done);
+    ASSERT_EQ(alloc.waiter_count(), 1u);
+
+    // placing the woken request needs storage for the regions split off, which is what fails
+    fail_allocations = true;
+    EXPECT_THROW(alloc.deallocate(*whole), std::bad_alloc);
+    fail_allocations = false;
+    EXPECT_FALSE(done);
+    EXPECT_EQ(alloc.waiter_count(), 1u);
+
+    // destroying the parked coroutine still withdraws its request
+    task.handle.destroy();
+    EXPECT_EQ(alloc.waiter_count(), 0u);
+}
+
+TEST(Allocator2D, FailedDirtyRecordLeavesAllocationLive) {
+    mo_yanxi::allocator2d<failing_allocator<std::byte>> alloc{{64, 64}};
+    alloc.track_dirty(true);
+    const auto a = alloc.allocate({16, 16});
+    ASSERT_TRUE(a);
+    // taking the list leaves no capacity, so the next rect needs storage
+    ASSERT_EQ(alloc.take_dirty().size(), 1u);
+
+    fail_allocations = true;
+    EXPECT_THROW(alloc.deallocate(*a), std::bad_alloc);
+    fail_allocations = false;
+    EXPECT_EQ(alloc.remain_area(), 64u * 64u - 16u * 16u);
+    EXPECT_TRUE(alloc.validate());
+
+    EXPECT_TRUE(alloc.deallocate(*a));
+    EXPECT_EQ(alloc.take_dirty().size(), 1u);
+    EXPECT_TRUE(alloc.validate());
+}
+
+TEST(BuddyAllocator, SplitsAndCoalescesBuddies) {
+    mo_yanxi::buddy_allocator2d<> alloc{64, 4};
+    EXPECT_EQ(alloc.extent(), (mo_yanxi::math::usize2{64, 64}));
+    EXPECT_TRUE(alloc.validate());
+
+    // the lowest free block in Morton order, so quadrants fill bottom-left first
+    const auto a = alloc.allocate({16, 16});
+    const auto b = alloc.allocate({16, 16});
+    const auto c = alloc.allocate({16, 16});
+    ASSERT_TRUE(a && b && c);
+    EXPECT_EQ(*a, (mo_yanxi::math::usize2{0, 0}));
+    EXPECT_EQ(*b, (mo_yanxi::math::usize2{16, 0}));
+    EXPECT_EQ(*c, (mo_yanxi::math::usize2{0, 16}));
+
+    // requests round up to the smallest power-of-two square block, never below min_side
+    EXPECT_EQ(alloc.block_side({9, 3}), 16u);
+    EXPECT_EQ(alloc.block_side({1, 1}), 4u);
+    const auto remain = alloc.remain_area();
+    const auto d = alloc.allocate({9, 3});
+    ASSERT_TRUE(d);
+    EXPECT_EQ(*d, (mo_yanxi::math::usize2{16, 16}));
+    EXPECT_EQ(alloc.remain_area(), remain - 16 * 16);
+    EXPECT_FALSE(alloc.allocate({33, 1}));
+    EXPECT_TRUE(alloc.validate());
+
+    // only the point of a live block is accepted
+    EXPECT_FALSE(alloc.deallocate({4, 0}));
+    EXPECT_FALSE(alloc.deallocate({32, 32}));
+    EXPECT_TRUE(alloc.deallocate(*b));
+    EXPECT_FALSE(alloc.deallocate(*b));
+
+    // freeing the last of four buddies merges them at once, up to the whole square
+    EXPECT_TRUE(alloc.deallocate(*a));
+    EXPECT_TRUE(alloc.deallocate(*c));
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_FALSE(alloc.allocate({64, 64}));
+    EXPECT_TRUE(alloc.deallocate(*d));
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_EQ(alloc.remain_area(), 64u * 64u);
+    EXPECT_EQ(alloc.allocate({64, 64}), (mo_yanxi::math::usize2{0, 0}));
+}
+
+TEST(BuddyAllocator, AcceptsRequestsWhoseAreaOverflowsTheCoordinates) {
+    // 65536^2 and 131072^2 wrap to 0 in 32 bits, yet are valid requests
+    mo_yanxi::buddy_allocator2d<> alloc{1u << 17, 1u << 13};
+    const auto full = alloc.allocate({1u << 17, 1u << 17});
+    ASSERT_TRUE(full);
+    EXPECT_EQ(*full, (mo_yanxi::math::usize2{0, 0}));
+    EXPECT_EQ(alloc.remain_area(), 0u);
+    EXPECT_TRUE(alloc.deallocate(*full));
+
+    const auto quarter = alloc.allocate({1u << 16, 1u << 16});
+    ASSERT_TRUE(quarter);
+    EXPECT_EQ(*quarter, (mo_yanxi::math::usize2{0, 0}));
+    EXPECT_EQ(alloc.remain_area(), 3ull << 32);
+    EXPECT_FALSE(alloc.allocate({0, 1u << 16}));
+    EXPECT_TRUE(alloc.deallocate(*quarter));
+    EXPECT_TRUE(alloc.validate());
+    EXPECT_EQ(alloc.remain_area(), 1ull << 34);
+}
+
+TEST(BuddyAllocator, RejectsInvalidGeometry) {
+    using buddy = mo_yanxi::buddy_allocator2d<>;
+    EXPECT_THROW(buddy(48), std::invalid_argument);
+    EXPECT_THROW(buddy(64, 3), std::invalid_argument);
+    EXPECT_THROW(buddy(64, 128), std::invalid_argument);
+    EXPECT_THROW(buddy(0), std::invalid_argument);
+    // 65536 down to single texels needs 17 levels
+    EXPECT_THROW(buddy(1u << 16), std::length_error);
+    EXPECT_NO_THROW(buddy(1u << 16, 1u << 8));
+    EXPECT_NO_THROW(buddy(64, 64));
+}
+
+TEST(SharedArena, AllocatorStateSurvivesRelocation) {
+    using shared_allocator = mo_yanxi::allocator2d<mo_yanxi::arena_allocator<std::byte>>;
+    static_assert(shared_allocator::position_independent);
+    static_assert(!mo_yanxi::allocator2d<>::position_independent);
+
+    struct shared_state {
+        mo_yanxi::shared_spin_lock lock;
+        shared_allocator alloc;
+        mo_yanxi::offset_ptr<std::uint32_t> payload;
+    };
+
+    // the block as a second process would see it: same bytes, another address
+    constexpr std::size_t block_size = 1 << 20;
+    auto first = std::make_unique<std::max_align_t[]>(block_size / sizeof(std::max_align_t));
+    auto* arena = mo_yanxi::shared_arena::create(first.get(), block_size);
+    auto* state = ::new (arena->allocate(sizeof(shared_state))) shared_state{{}, shared_allocator{mo_yanxi::arena_allocator<std::byte>{*arena}, {256, 256}}, {}};
+    arena->set_root(state);
+    constexpr std::size_t payload_size = 64;
+    state->payload = static_cast<std::uint32_t*>(arena->allocate(payload_size * sizeof(std::uint32_t)));
+    for (std::size_t i = 0; i < payload_size; ++i) {
+        state->payload[static_cast<std::ptrdiff_t>(i)] = static_cast<std::uint32_t>(i * 7 + 3);
+    }
+    const auto state_offset = reinterpret_cast<std::byte*>(state) - reinterpret_cast<std::byte*>(first.get());
+
+    // placements match the pointer-based allocator, which sorts large regions in its own index
+    mo_yanxi::allocator2d<> reference{{256, 256}};
+    std::mt19937 rng{48};
+    std::vector<usize2> live;
+    const auto churn = [&](shared_allocator& alloc, const int steps) {
+        for (int i = 0; i < steps; ++i) {
+            std::lock_guard guard{reinterpret_cast<shared_state*>(arena->root())->lock};
+            if (live.empty() || rng() % 3) {
+                const usize2 extent{1 + static_cast<std::uint32_t>(rng() % 40), 1 + static_cast<std::uint32_t>(rng() % 40)};
+                const auto pos = alloc.allocate(extent);
+                ASSERT_EQ(pos, reference.allocate(extent));
+                if (pos) live.push_back(*pos);
+            } else {
+                const auto index = rng() % live.size();
+                ASSERT_TRUE(alloc.deallocate(live[index]));
+                ASSERT_TRUE(reference.deallocate(live[index]));
+                live[index] = live.back();
+                live.pop_back();
+            }
+        }
+        EXPECT_TRUE(alloc.validate());
+    };
+    churn(state->alloc, 400);
+    EXPECT_GT(arena->used(), sizeof(mo_yanxi::shared_arena));
+
+    // any address left in the state would now point into freed memory
+    auto second = std::make_unique<std::max_align_t[]>(block_size / sizeof(std::max_align_t));
+    std::memcpy(second.get(), first.get(), block_size);
+    first.reset();
+    arena = mo_yanxi::shared_arena::attach(second.get());
+    state = static_cast<shared_state*>(arena->root());
+    const auto* second_begin = reinterpret_cast<const std::byte*>(second.get());
+    const auto in_second = [&](const void* pointer) {
+        const auto* byte = static_cast<const std::byte*>(pointer);
+        return std::less_equal<>{}(second_begin, byte) && std::less<>{}(byte, second_begin + block_size);
+    };
+    ASSERT_EQ(reinterpret_cast<std::byte*>(state), reinterpret_cast<std::byte*>(second.get()) + state_offset);
+    ASSERT_TRUE(in_second(state->payload.get()));
+    ASSERT_TRUE(in_second(state->payload.get() + payload_size - 1));
+    for (std::size_t i = 0; i < payload_size; ++i) {
+        EXPECT_EQ(state->payload[static_cast<std::ptrdiff_t>(i)], i * 7 + 3);
+    }
+
+    EXPECT_EQ(state->alloc.remain_area(), reference.remain_area());
+    churn(state->alloc, 400);
+    for (const auto pos : live) {
+        EXPECT_TRUE(state->alloc.deallocate(pos));
+    }
+    EXPECT_TRUE(state->alloc.validate());
+    EXPECT_EQ(state->alloc.allocate({256, 256}), (usize2{0, 0}));
+
+    // exhausting the arena reports bad_alloc like any allocator
+    EXPECT_THROW((void)arena->allocate(block_size), std::bad_alloc);
+    state->~shared_state();
+}
@@ -0,0 +1,225 @@
+// Differential fuzz target: replays a byte stream as allocator operations against a brute-force
+// occupancy model and checks allocator2d::validate after every step.
+//
+// Built with libFuzzer (clang -fsanitize=fuzzer) it exposes LLVMFuzzerTestOneInput; with
+// ALLOCATOR2D_FUZZ_STANDALONE defined it gets a main that replays the files given on the
+// command line, or a fixed number of random inputs when there are none.
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "mo_yanxi/allocator2d.hpp"
+
+namespace {
+
+using allocator_type = mo_yanxi::allocator2d<>;
+using region = allocator_type::region;
+using mo_yanxi::math::usize2;
+
+constexpr std::uint32_t max_extent = 192;
+
+[[noreturn]] void fail(const char* what, const std::size_t step) {
+    std::fprintf(stderr, "allocator2d fuzz: %s at step %zu\n", what, step);
+    std::abort();
+}
+
+struct byte_reader {
+    const std::uint8_t* data;
+    std::size_t size;
+
+    std::uint8_t next() noexcept {
+        if (size == 0) return 0;
+        --size;
+        return *data++;
+    }
+};
+
+struct model {
+    usize2 extent{};
+    std::vector<std::uint8_t> cells = std::vector<std::uint8_t>(max_extent * max_extent);
+    std::vector<region> live{};
+
+    void paint(const region& rect, const std::uint8_t value, const std::size_t step) {
+        const auto end = rect.end();
+        if (end.x > extent.x || end.y > extent.y) fail("allocation out of bounds", step);
+        for (auto y = rect.src.y; y < end.y; ++y) {
+            for (auto x = rect.src.x; x < end.x; ++x) {
+                auto& cell = cells[y * max_extent + x];
+                if (value && cell) fail("overlapping allocation", step);
+                cell = value;
+            }
+        }
+    }
+
+    void add(const region& rect, const std::size_t step) {
+        paint(rect, 1, step);
+        live.push_back(rect);
+    }
+
+    void remove(const region& rect, const std::size_t step) {
+        const auto it = std::ranges::find(live, rect);
+        if (it == live.end()) fail("released an unknown allocation", step);
+        paint(rect, 0, step);
+        *it = live.back();
+        live.pop_back();
+    }
+
+    [[nodiscard]] std::uint64_t used_area() const noexcept {
+        std::uint64_t area{};
+        for (const auto& rect : live) area += mo_yanxi::area_of(rect.extent);
+        return area;
+    }
+};
+
+void run(const std::uint8_t* data, const std::size_t size) {
+    byte_reader input{data, size};
+
+    model state{};
+    state.extent = {1u + input.next() % 128u, 1u + input.next() % 128u};
+    const auto threshold = input.next();
+    allocator_type alloc{state.extent, threshold * 4u};
+    // odd thresholds also exercise the adaptive threshold and its incremental repartitioning
+    alloc.adapt_fragment_threshold(threshold & 1);
+    // every other threshold starts on the subtree search and switches engines every 64 steps
+    alloc.use_subtree_search(threshold & 2);
+
+    for (std::size_t step = 0; input.size > 0; ++step) {
+        if ((threshold & 2) && step % 64 == 63) alloc.use_subtree_search(!alloc.uses_subtree_search());
+        const auto op = input.next() % 16;
+        const auto a = input.next();
+        const auto b = input.next();
+        const usize2 extent{1u + a % 48u, 1u + b % 48u};
+
+        switch (op) {
+        case 0: case 1: case 2: case 3: case 4:
+            if (const auto pos = alloc.allocate(extent)) state.add({*pos, extent}, step);
+            break;
+        case 5: case 6: case 7:
+            if (!state.live.empty()) {
+                const auto rect = state.live[(a << 8 | b) % state.live.size()];
+                if (!alloc.deallocate(rect.src)) fail("deallocate rejected a live allocation", step);
+                state.remove(rect, step);
+            }
+            break;
+        case 8: {
+            // a point that is not the start of a live allocation must be rejected
+            const usize2 point{a % max_extent, b % max_extent};
+            const bool is_live = std::ranges::any_of(state.live, [&](const region& rect) { return rect.src == point; });
+            if (is_live) {
+                const auto rect = *std::ranges::find_if(state.live, [&](const region& r) { return r.src == point; });
+                if (!alloc.deallocate(point)) fail("deallocate rejected a live allocation", step);
+                state.remove(rect, step);
+            } else if (alloc.deallocate(point)) {
+                fail("deallocate accepted a free point", step);
+            }
+            break;
+        }
+        case 9: {
+            const usize2 grown{std::min(max_extent, state.extent.x + a % 32u), std::min(max_extent, state.extent.y + b % 32u)};
+            if (!alloc.grow(grown)) fail("grow rejected a larger extent", step);
+            state.extent = grown;
+            break;
+        }
+        case 10: {
+            const auto trimmed = alloc.trim();
+            if (trimmed.beyond(state.extent)) fail("trim enlarged the extent", step);
+            state.extent = trimmed;
+            for (const auto& rect : state.live) {
+                if (rect.end().beyond(trimmed)) fail("trim cut into an allocation", step);
+            }
+            break;
+        }
+        case 11: {
+            const auto cost = [&](const region& rect) { return (rect.src.x ^ rect.src.y ^ a) & 15; };
+            const auto pos = alloc.allocate_with_eviction(extent, cost, [&](const region& rect) { state.remove(rect, step); });
+            if (pos) {
+                state.add({*pos, extent}, step);
+            } else if (!extent.beyond(state.extent)) {
+                fail("eviction failed for an extent that fits", step);
+            }
+            break;
+        }
+        case 12: {
+            if (const auto handle = alloc.allocate_handle(extent)) {
+                state.add({handle->point, extent}, step);
+                if (b & 1) {
+                    if (!alloc.deallocate(*handle)) fail("deallocate rejected a live handle", step);
+                    state.remove({handle->point, extent}, step);
+                    if (alloc.deallocate(*handle)) fail("deallocate accepted a released handle", step);
+                }
+            }
+            break;
+        }
+        case 13: {
+            // succeeds only inside a single free region; the model catches any overlap
+            if (state.extent.x == 0 || state.extent.y == 0) break;
+            const region rect{{a % state.extent.x, b % state.extent.y}, {1u + b % 24u, 1u + a % 24u}};
+            const auto remain = alloc.remain_area();
+            if (alloc.reserve(rect.src, rect.extent)) {
+                state.add(rect, step);
+            } else if (alloc.remain_area() != remain) {
+                fail("rejected reserve changed the allocator", step);
+            }
+            break;
+        }
+        default: {
+            std::size_t found{};
+            alloc.query({{a % max_extent, b % max_extent}, extent}, [&](const region&) { ++found; });
+            const region area{{a % max_extent, b % max_extent}, extent};
+            const auto expected = std::ranges::count_if(state.live, [&](const region& rect) { return rect.overlaps(area); });
+            if (found != static_cast<std::size_t>(expected)) fail("query disagrees with the model", step);
+            break;
+        }
+        }
+
+        if (alloc.extent() != state.extent) fail("extent disagrees with the model", step);
+        if (alloc.remain_area() + state.used_area() != mo_yanxi::area_of(state.extent)) fail("area disagrees with the model", step);
+        if (!alloc.validate()) fail("validate failed", step);
+    }
+
+    for (const auto rect : std::vector<region>{state.live}) {
+        if (!alloc.deallocate(rect.src)) fail("deallocate rejected a live allocation", 0);
+        state.remove(rect, 0);
+    }
+    if (alloc.remain_area() != mo_yanxi::area_of(state.extent) || !alloc.validate()) {
+        fail("allocator did not merge back after releasing everything", 0);
+    }
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const std::uint8_t* data, const std::size_t size) {
+    run(data, size);
+    return 0;
+}
+
+#ifdef ALLOCATOR2D_FUZZ_STANDALONE
+#include <fstream>
+#include <iterator>
+#include <random>
+
+int main(const int argc, char** argv) {
+    if (argc > 1) {
+        for (int i = 1; i < argc; ++i) {
+            std::ifstream file{argv[i], std::ios::binary};
+            const std::vector<std::uint8_t> bytes{std::istreambuf_iterator<char>{file}, std::istreambuf_iterator<char>{}};
+            LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+        }
+        return 0;
+    }
+
+    std::mt19937 rng{20240601};
+    std::vector<std::uint8_t> bytes;
+    for (int run = 0; run < 500; ++run) {
+        bytes.resize(3 + rng() % 3000);
+        for (auto& byte : bytes) byte = static_cast<std::uint8_t>(rng());
+        LLVMFuzzerTestOneInput(bytes.data(), bytes.size());
+    }
+    std::puts("allocator2d fuzz: ok");
+    return 0;
+}
+#endif